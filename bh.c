@@ -6,6 +6,7 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/gpio/consumer.h>
+#include <linux/moduleparam.h>
 #include <net/mac80211.h>
 
 #include "bh.h"
@@ -16,15 +17,28 @@
 #include "hif_rx.h"
 #include "hif_api_cmd.h"
 
-static void device_wakeup(struct wfx_dev *wdev)
+/* Period used to measure the load of the bus */
+#define WFX_LOAD_WINDOW_MS 250
+
+/* Maximum number of messages sent (or received) in a row before switching direction */
+#define WFX_BH_BUDGET 32
+
+static unsigned int wakeup_hold_off = 10;
+module_param(wakeup_hold_off, uint, 0644);
+MODULE_PARM_DESC(wakeup_hold_off, "delay (in ms) before putting the chip asleep under sustained traffic (default: 10, 0 to disable).");
+
+static unsigned int wakeup_busy_load = 100;
+module_param(wakeup_busy_load, uint, 0644);
+MODULE_PARM_DESC(wakeup_busy_load, "number of bus transfers per second above which the hold-off delay applies (default: 100).");
+
+static unsigned int wakeup_idle_load = 20;
+module_param(wakeup_idle_load, uint, 0644);
+MODULE_PARM_DESC(wakeup_idle_load, "number of bus transfers per second below which the chip is put asleep immediately (default: 20).");
+
+static void device_wakeup_gpio(struct wfx_dev *wdev)
 {
 	int max_retry = 3;
 
-	if (!wdev->pdata.gpio_wakeup)
-		return;
-	if (gpiod_get_value_cansleep(wdev->pdata.gpio_wakeup) > 0)
-		return;
-
 	if (wfx_api_older_than(wdev, 1, 4)) {
 		gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 1);
 		if (!completion_done(&wdev->hif.ctrl_ready))
@@ -53,12 +67,101 @@ static void device_wakeup(struct wfx_dev *wdev)
 	}
 }
 
-static void device_release(struct wfx_dev *wdev)
+static void device_wakeup(struct wfx_dev *wdev)
 {
+	struct wfx_hif *hif = &wdev->hif;
+	ktime_t start;
+
 	if (!wdev->pdata.gpio_wakeup)
 		return;
+	mutex_lock(&hif->chip_state_lock);
+	if (hif->chip_state == WFX_CHIP_HOLD_OFF) {
+		/* The chip is still awake. release_work will find nothing to do. */
+		hif->chip_state = WFX_CHIP_AWAKE;
+		hif->num_wakeups_saved++;
+		mutex_unlock(&hif->chip_state_lock);
+		return;
+	}
+	hif->chip_state = WFX_CHIP_AWAKE;
+	if (gpiod_get_value_cansleep(wdev->pdata.gpio_wakeup) > 0) {
+		mutex_unlock(&hif->chip_state_lock);
+		return;
+	}
+	start = ktime_get();
+	device_wakeup_gpio(wdev);
+	hif->num_wakeups++;
+	wfx_hist_add(&hif->wakeup_latency, ktime_us_delta(ktime_get(), start));
+	mutex_unlock(&hif->chip_state_lock);
+}
 
+/* Must be called with chip_state_lock held */
+static void device_release(struct wfx_dev *wdev)
+{
 	gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 0);
+	wdev->hif.chip_state = WFX_CHIP_ASLEEP;
+	wdev->hif.num_releases++;
+}
+
+/* The load is the number of bh_work() runs that did transfer data during the last period. The
+ * thresholds are distinct to avoid oscillating between the two modes.
+ */
+static void device_update_load(struct wfx_dev *wdev, bool active, ktime_t now)
+{
+	struct wfx_hif *hif = &wdev->hif;
+	s64 elapsed;
+	u64 load;
+
+	if (active) {
+		hif->last_activity = now;
+		hif->load_window_events++;
+	}
+	elapsed = ktime_to_ms(ktime_sub(now, hif->load_window_start));
+	if (elapsed < WFX_LOAD_WINDOW_MS)
+		return;
+	load = div64_s64((s64)hif->load_window_events * MSEC_PER_SEC, elapsed);
+	if (load >= wakeup_busy_load)
+		hif->load_busy = true;
+	else if (load <= wakeup_idle_load)
+		hif->load_busy = false;
+	hif->load_window_start = now;
+	hif->load_window_events = 0;
+}
+
+/* Under sustained traffic, waking up the chip for every transfer costs more than keeping it awake
+ * a few milliseconds. So, in this case, the chip is only released once it has stayed idle during
+ * wakeup_hold_off.
+ */
+static bool device_try_release(struct wfx_dev *wdev, ktime_t now)
+{
+	struct wfx_hif *hif = &wdev->hif;
+	ktime_t deadline;
+
+	if (!wdev->pdata.gpio_wakeup)
+		return true;
+	mutex_lock(&hif->chip_state_lock);
+	deadline = ktime_add_ms(hif->last_activity, wakeup_hold_off);
+	if (!hif->load_busy || !wakeup_hold_off || !ktime_before(now, deadline)) {
+		device_release(wdev);
+		mutex_unlock(&hif->chip_state_lock);
+		return true;
+	}
+	hif->chip_state = WFX_CHIP_HOLD_OFF;
+	mod_delayed_work(wdev->bh_wq, &hif->release_work,
+			 usecs_to_jiffies(ktime_us_delta(deadline, now)));
+	mutex_unlock(&hif->chip_state_lock);
+	return false;
+}
+
+static void device_release_work(struct work_struct *work)
+{
+	struct wfx_hif *hif = container_of(to_delayed_work(work), struct wfx_hif, release_work);
+	struct wfx_dev *wdev = container_of(hif, struct wfx_dev, hif);
+
+	mutex_lock(&hif->chip_state_lock);
+	/* If bh_work() ran in the meantime, it is in charge of the chip state */
+	if (hif->chip_state == WFX_CHIP_HOLD_OFF)
+		device_release(wdev);
+	mutex_unlock(&hif->chip_state_lock);
 }
 
 static int rx_helper(struct wfx_dev *wdev, size_t read_len, int *is_cnf)
@@ -180,12 +283,21 @@ static int bh_work_rx(struct wfx_dev *wdev, int max_msg, int *num_cnf)
 
 	piggyback = 0;
 	for (i = 0; i < max_msg; i++) {
-		if (piggyback & CTRL_NEXT_LEN_MASK)
+		if (piggyback & CTRL_NEXT_LEN_MASK) {
 			ctrl_reg = piggyback;
-		else if (try_wait_for_completion(&wdev->hif.ctrl_ready))
+			spin_lock(&wdev->hif.stats_lock);
+			wdev->hif.stats.num_rx_piggyback++;
+			spin_unlock(&wdev->hif.stats_lock);
+		} else if (try_wait_for_completion(&wdev->hif.ctrl_ready)) {
 			ctrl_reg = atomic_xchg(&wdev->hif.ctrl_reg, 0);
-		else
+			if (ctrl_reg & CTRL_NEXT_LEN_MASK) {
+				spin_lock(&wdev->hif.stats_lock);
+				wdev->hif.stats.num_rx_irq++;
+				spin_unlock(&wdev->hif.stats_lock);
+			}
+		} else {
 			ctrl_reg = 0;
+		}
 		if (!(ctrl_reg & CTRL_NEXT_LEN_MASK))
 			return i;
 		/* ctrl_reg units are 16bits words */
@@ -291,32 +403,64 @@ static void ack_sdio_data(struct wfx_dev *wdev)
 	}
 }
 
+static void bh_update_stats(struct wfx_dev *wdev, int num_tx, int num_rx, ktime_t start,
+			    ktime_t now)
+{
+	struct wfx_bh_stats *stats = &wdev->hif.stats;
+	u64 delta = ktime_to_ns(ktime_sub(now, start));
+
+	spin_lock(&wdev->hif.stats_lock);
+	stats->num_passes++;
+	if (!num_tx && !num_rx)
+		stats->num_empty_passes++;
+	stats->num_tx += num_tx;
+	stats->num_rx += num_rx;
+	stats->time_ns += delta;
+	stats->max_ns = max(stats->max_ns, delta);
+	wfx_hist_add(&stats->msgs_per_pass, num_tx + num_rx);
+	wfx_hist_add(&stats->time_per_pass, div_u64(delta, NSEC_PER_USEC));
+	spin_unlock(&wdev->hif.stats_lock);
+}
+
 static void bh_work(struct work_struct *work)
 {
 	struct wfx_dev *wdev = container_of(work, struct wfx_dev, hif.bh);
 	int stats_req = 0, stats_cnf = 0, stats_ind = 0;
 	bool release_chip = false, last_op_is_rx = false;
 	int num_tx, num_rx;
+	ktime_t now, start;
 
 	device_wakeup(wdev);
+	start = ktime_get();
 	do {
-		num_tx = bh_work_tx(wdev, 32);
+		num_tx = bh_work_tx(wdev, WFX_BH_BUDGET);
 		stats_req += num_tx;
 		if (num_tx)
 			last_op_is_rx = false;
-		num_rx = bh_work_rx(wdev, 32, &stats_cnf);
+		if (num_tx == WFX_BH_BUDGET) {
+			spin_lock(&wdev->hif.stats_lock);
+			wdev->hif.stats.num_tx_budget_hits++;
+			spin_unlock(&wdev->hif.stats_lock);
+		}
+		num_rx = bh_work_rx(wdev, WFX_BH_BUDGET, &stats_cnf);
 		stats_ind += num_rx;
 		if (num_rx)
 			last_op_is_rx = true;
+		if (num_rx == WFX_BH_BUDGET) {
+			spin_lock(&wdev->hif.stats_lock);
+			wdev->hif.stats.num_rx_budget_hits++;
+			spin_unlock(&wdev->hif.stats_lock);
+		}
 	} while (num_rx || num_tx);
+	now = ktime_get();
+	bh_update_stats(wdev, stats_req, stats_ind, start, now);
+	device_update_load(wdev, stats_req || stats_ind, now);
 	stats_ind -= stats_cnf;
 
 	if (last_op_is_rx)
 		ack_sdio_data(wdev);
-	if (!wdev->hif.tx_buffers_used && !work_pending(work)) {
-		device_release(wdev);
-		release_chip = true;
-	}
+	if (!wdev->hif.tx_buffers_used && !work_pending(work))
+		release_chip = device_try_release(wdev, now);
 	_trace_bh_stats(stats_ind, stats_req, stats_cnf, wdev->hif.tx_buffers_used, release_chip);
 }
 
@@ -372,14 +516,70 @@ void wfx_bh_poll_irq(struct wfx_dev *wdev)
 	wfx_bh_request_rx(wdev);
 }
 
+/* Called after HIF_REQ_ID_SHUT_DOWN. The chip will not wake up anymore, so drop any pending
+ * hold-off and let the chip go to sleep.
+ */
+void wfx_bh_shutdown(struct wfx_dev *wdev)
+{
+	struct wfx_hif *hif = &wdev->hif;
+
+	mutex_lock(&hif->chip_state_lock);
+	/* If release_work is already running, it waits for the lock and finds nothing to do */
+	cancel_delayed_work(&hif->release_work);
+	if (wdev->pdata.gpio_wakeup) {
+		device_release(wdev);
+	} else {
+		wfx_control_reg_write(wdev, 0);
+		hif->chip_state = WFX_CHIP_ASLEEP;
+	}
+	mutex_unlock(&hif->chip_state_lock);
+}
+
+void wfx_bh_stats_reset(struct wfx_dev *wdev)
+{
+	spin_lock(&wdev->hif.stats_lock);
+	memset(&wdev->hif.stats, 0, sizeof(wdev->hif.stats));
+	spin_unlock(&wdev->hif.stats_lock);
+}
+
+void wfx_bh_stats_get(struct wfx_dev *wdev, struct wfx_bh_stats *stats)
+{
+	spin_lock(&wdev->hif.stats_lock);
+	*stats = wdev->hif.stats;
+	spin_unlock(&wdev->hif.stats_lock);
+}
+
 void wfx_bh_register(struct wfx_dev *wdev)
 {
 	INIT_WORK(&wdev->hif.bh, bh_work);
+	INIT_DELAYED_WORK(&wdev->hif.release_work, device_release_work);
 	init_completion(&wdev->hif.ctrl_ready);
 	init_waitqueue_head(&wdev->hif.tx_buffers_empty);
+	mutex_init(&wdev->hif.chip_state_lock);
+	spin_lock_init(&wdev->hif.stats_lock);
+	/* wfx_probe() leaves the chip awake */
+	wdev->hif.chip_state = WFX_CHIP_AWAKE;
+	wdev->hif.load_window_start = ktime_get();
 }
 
 void wfx_bh_unregister(struct wfx_dev *wdev)
 {
 	flush_work(&wdev->hif.bh);
+	cancel_delayed_work_sync(&wdev->hif.release_work);
+}
+
+/* Forget the state shared with the firmware. The caller must ensure the chip has been reset and
+ * the IRQ is disabled.
+ */
+void wfx_bh_reset(struct wfx_dev *wdev)
+{
+	wfx_bh_unregister(wdev);
+	atomic_set(&wdev->hif.ctrl_reg, 0);
+	wdev->hif.rx_seqnum = 0;
+	wdev->hif.tx_seqnum = 0;
+	wdev->hif.tx_buffers_used = 0;
+	wake_up(&wdev->hif.tx_buffers_empty);
+	mutex_lock(&wdev->hif.chip_state_lock);
+	wdev->hif.chip_state = WFX_CHIP_AWAKE;
+	mutex_unlock(&wdev->hif.chip_state_lock);
 }
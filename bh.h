@@ -12,23 +12,69 @@
 #include <linux/wait.h>
 #include <linux/completion.h>
 #include <linux/workqueue.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+
+#include "debug.h"
 
 struct wfx_dev;
 
+enum wfx_chip_state {
+	WFX_CHIP_ASLEEP,
+	WFX_CHIP_AWAKE,
+	/* Chip is idle, but kept awake until the hold-off delay expires */
+	WFX_CHIP_HOLD_OFF,
+};
+
+/* Cumulative statistics of bh_work(). A pass is one run of bh_work(). */
+struct wfx_bh_stats {
+	u64 num_passes;
+	u64 num_empty_passes;   /* nothing to send or to receive */
+	u64 num_tx;
+	u64 num_rx;             /* indications and confirmations */
+	u64 num_rx_piggyback;   /* read thanks to the piggyback of the previous message */
+	u64 num_rx_irq;         /* read after an IRQ */
+	u64 num_tx_budget_hits; /* bh_work_tx() stopped because of the budget */
+	u64 num_rx_budget_hits; /* bh_work_rx() stopped because of the budget */
+	u64 time_ns;
+	u64 max_ns;
+	struct wfx_hist msgs_per_pass;
+	struct wfx_hist time_per_pass; /* in us */
+};
+
 struct wfx_hif {
 	struct work_struct bh;
+	struct delayed_work release_work;
 	struct completion ctrl_ready;
 	wait_queue_head_t tx_buffers_empty;
 	atomic_t ctrl_reg;
 	int rx_seqnum;
 	int tx_seqnum;
 	int tx_buffers_used;
+	/* Chip wake-up state machine */
+	struct mutex chip_state_lock;
+	enum wfx_chip_state chip_state;
+	ktime_t last_activity;
+	ktime_t load_window_start;
+	int load_window_events;
+	bool load_busy;
+	/* Statistics */
+	unsigned long num_wakeups;
+	unsigned long num_releases;
+	unsigned long num_wakeups_saved;
+	struct wfx_hist wakeup_latency;
+	spinlock_t stats_lock; /* Protects stats */
+	struct wfx_bh_stats stats;
 };
 
 void wfx_bh_register(struct wfx_dev *wdev);
 void wfx_bh_unregister(struct wfx_dev *wdev);
+void wfx_bh_reset(struct wfx_dev *wdev);
+void wfx_bh_shutdown(struct wfx_dev *wdev);
 void wfx_bh_request_rx(struct wfx_dev *wdev);
 void wfx_bh_request_tx(struct wfx_dev *wdev);
 void wfx_bh_poll_irq(struct wfx_dev *wdev);
+void wfx_bh_stats_reset(struct wfx_dev *wdev);
+void wfx_bh_stats_get(struct wfx_dev *wdev, struct wfx_bh_stats *stats);
 
 #endif
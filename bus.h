@@ -28,9 +28,14 @@ struct wfx_hwbus_ops {
 	void (*lock)(void *bus_priv);
 	void (*unlock)(void *bus_priv);
 	size_t (*align_size)(void *bus_priv, size_t size);
+	/* Optional. Hard reset the chip. Used to recover a frozen chip. */
+	int (*reset)(void *bus_priv);
 };
 
 extern struct sdio_driver wfx_sdio_driver;
 extern struct spi_driver wfx_spi_driver;
 
+int wfx_emul_register(void);
+void wfx_emul_unregister(void);
+
 #endif
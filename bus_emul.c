@@ -0,0 +1,817 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Emulated bus. Allow to run the driver without hardware (mainly for benchmarks).
+ *
+ * Copyright (c) 2017-2020, Silicon Laboratories, Inc.
+ */
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/skbuff.h>
+#include <linux/etherdevice.h>
+#include <linux/ieee80211.h>
+#include <asm/unaligned.h>
+
+#include "bus.h"
+#include "wfx.h"
+#include "hwio.h"
+#include "fwio.h"
+#include "main.h"
+#include "bh.h"
+#include "hif_api_cmd.h"
+#include "hif_api_mib.h"
+
+/* Below values must match fwio.c */
+#define WFX_DCA_PUT               0x0900C004
+#define WFX_DCA_GET               0x0900C008
+#define WFX_DCA_HOST_STATUS       0x0900C00C
+#define     HOST_READY                0x87654321
+#define     HOST_INFO_READ            0xA753BD99
+#define     HOST_UPLOAD_PENDING       0xABCDDCBA
+#define     HOST_UPLOAD_COMPLETE      0xD4C64A99
+#define     HOST_OK_TO_JUMP           0x174FC882
+#define WFX_DCA_NCP_STATUS        0x0900C010
+#define     NCP_NOT_READY             0x12345678
+#define     NCP_READY                 0x87654321
+#define     NCP_INFO_READY            0xBD53EF99
+#define     NCP_DOWNLOAD_PENDING      0xABCDDCBA
+#define     NCP_AUTH_OK               0xD4C64A99
+#define WFX_STATUS_INFO           0x0900C080
+#define WFX_BOOTLOADER_LABEL      0x0900C084
+#define WFX_PTE_INFO              0x0900C0C0
+#define     PTE_INFO_KEYSET_IDX       0x0D
+
+#define WFX_EMUL_MAX_DEVICES  4
+#define WFX_EMUL_MAX_BUFS     64
+/* Number of RX indications the chip can store before the host reads them */
+#define WFX_EMUL_MAX_RX       64
+/* Max number of RX indications generated by one event (if the system is late) */
+#define WFX_EMUL_RX_BURST     32
+#define WFX_EMUL_KEYSET       0xEE
+/* Hardware revision 1 */
+#define WFX_EMUL_CONFIG_REG   0x01000000
+#define WFX_EMUL_FW_LEN       1024
+
+static unsigned int emul_num_devices = 1;
+module_param(emul_num_devices, uint, 0444);
+MODULE_PARM_DESC(emul_num_devices, "number of emulated devices (default: 1, max: 4).");
+
+static unsigned int emul_num_bufs = 30;
+module_param(emul_num_bufs, uint, 0444);
+MODULE_PARM_DESC(emul_num_bufs, "number of input buffers of the emulated chip (default: 30, max: 64).");
+
+static unsigned int emul_cmd_latency_us = 100;
+module_param(emul_cmd_latency_us, uint, 0644);
+MODULE_PARM_DESC(emul_cmd_latency_us, "delay (in us) before the emulated chip answers a command (default: 100).");
+
+static unsigned int emul_tx_latency_us = 500;
+module_param(emul_tx_latency_us, uint, 0644);
+MODULE_PARM_DESC(emul_tx_latency_us, "delay (in us) before the emulated chip confirms a frame (default: 500).");
+
+static unsigned int emul_multi_tx_cnf = 8;
+module_param(emul_multi_tx_cnf, uint, 0644);
+MODULE_PARM_DESC(emul_multi_tx_cnf, "max number of TX confirmations grouped in one message (default: 8).");
+
+static unsigned int emul_rx_rate;
+module_param(emul_rx_rate, uint, 0644);
+MODULE_PARM_DESC(emul_rx_rate, "number of frames received per second by each associated interface (default: 0).");
+
+static unsigned int emul_rx_len = 1500;
+module_param(emul_rx_len, uint, 0644);
+MODULE_PARM_DESC(emul_rx_len, "size of the received frames (default: 1500).");
+
+struct wfx_emul_tx {
+	u32 packet_id;
+	u8 interface;
+	u8 txed_rate;
+	ktime_t due;
+};
+
+struct wfx_emul_vif {
+	bool active;
+	u8 channel;
+	u8 bssid[ETH_ALEN];
+};
+
+struct wfx_emul_stats {
+	u32 num_req;
+	u32 num_cnf;
+	u32 num_tx_cnf;
+	u32 num_multi_tx_cnf;
+	u32 num_ind_rx;
+	u32 num_rx_drops;
+	u32 num_overruns;
+};
+
+/* Stored in skb->cb of the messages sent to the host */
+struct wfx_emul_cb {
+	ktime_t due;
+	int num_release;
+};
+
+struct wfx_emul {
+	struct platform_device *pdev;
+	struct wfx_dev *core;
+	/* Protect all the fields below */
+	struct mutex lock;
+	struct hrtimer timer;
+	struct work_struct event_work;
+	bool stopped;
+	bool irq_enabled;
+	u32 config_reg;
+	u32 control_reg;
+	u32 base_addr;
+	u32 ncp_status;
+	u32 dca_put;
+	int num_bufs;
+	int bufs_used;
+	bool multi_tx_cnf;
+	u8 seqnum;
+	u16 rx_seqnum;
+	u8 mac_addr[2][ETH_ALEN];
+	struct wfx_emul_vif vif[2];
+	/* Confirmations and indications not yet due */
+	struct sk_buff_head pending;
+	/* Messages available for the host */
+	struct sk_buff_head rx_queue;
+	struct wfx_emul_tx tx[WFX_EMUL_MAX_BUFS];
+	int tx_head;
+	int tx_count;
+	ktime_t next_rx;
+	struct wfx_emul_stats stats;
+};
+
+static const struct wfx_platform_data pdata_emul = {
+	.file_fw = "wfx/wfm_emul",
+	.file_pds = "wfx/emul.pds",
+};
+
+static struct platform_device *wfx_emul_devices[WFX_EMUL_MAX_DEVICES];
+
+static struct wfx_emul_cb *wfx_emul_cb(struct sk_buff *skb)
+{
+	return (struct wfx_emul_cb *)skb->cb;
+}
+
+static void *wfx_emul_alloc_msg(int id, int if_id, size_t body_len, struct sk_buff **skb)
+{
+	struct wfx_hif_msg *hif;
+
+	*skb = alloc_skb(sizeof(*hif) + body_len, GFP_KERNEL);
+	if (!*skb)
+		return NULL;
+	hif = skb_put_zero(*skb, sizeof(*hif) + body_len);
+	hif->len = cpu_to_le16(sizeof(*hif) + body_len);
+	hif->id = id;
+	hif->interface = if_id;
+	return hif->body;
+}
+
+/* Make the message available to the host */
+static void wfx_emul_push_rx(struct wfx_emul *emul, struct sk_buff *skb)
+{
+	struct wfx_hif_msg *hif = (struct wfx_hif_msg *)skb->data;
+
+	hif->seqnum = emul->seqnum;
+	emul->seqnum = (emul->seqnum + 1) % (HIF_COUNTER_MAX + 1);
+	__skb_queue_tail(&emul->rx_queue, skb);
+}
+
+static void wfx_emul_push_pending(struct wfx_emul *emul, struct sk_buff *skb,
+				  int num_release, unsigned int latency_us)
+{
+	wfx_emul_cb(skb)->due = ktime_add_us(ktime_get(), latency_us);
+	wfx_emul_cb(skb)->num_release = num_release;
+	__skb_queue_tail(&emul->pending, skb);
+}
+
+static void wfx_emul_arm_timer(struct wfx_emul *emul)
+{
+	struct sk_buff *skb;
+	ktime_t next = KTIME_MAX;
+
+	if (emul->stopped)
+		return;
+	skb = skb_peek(&emul->pending);
+	if (skb)
+		next = wfx_emul_cb(skb)->due;
+	if (emul->tx_count)
+		next = min(next, emul->tx[emul->tx_head].due);
+	if (emul->next_rx)
+		next = min(next, emul->next_rx);
+	if (next != KTIME_MAX)
+		hrtimer_start(&emul->timer, next, HRTIMER_MODE_ABS);
+}
+
+static u32 wfx_emul_control_reg(struct wfx_emul *emul)
+{
+	struct sk_buff *skb = skb_peek(&emul->rx_queue);
+	u32 next_len = skb ? DIV_ROUND_UP(skb->len, 2) : 0;
+
+	if (next_len || emul->control_reg & CTRL_WLAN_WAKEUP)
+		return CTRL_WLAN_READY | next_len;
+	return 0;
+}
+
+static void wfx_emul_reset_state(struct wfx_emul *emul)
+{
+	emul->config_reg = WFX_EMUL_CONFIG_REG;
+	emul->control_reg = 0;
+	emul->base_addr = 0;
+	emul->ncp_status = NCP_NOT_READY;
+	emul->dca_put = 0;
+	emul->bufs_used = 0;
+	emul->multi_tx_cnf = false;
+	emul->seqnum = 0;
+	emul->tx_head = 0;
+	emul->tx_count = 0;
+	emul->next_rx = 0;
+	memset(emul->vif, 0, sizeof(emul->vif));
+	__skb_queue_purge(&emul->pending);
+	__skb_queue_purge(&emul->rx_queue);
+}
+
+static void wfx_emul_boot(struct wfx_emul *emul)
+{
+	struct wfx_hif_ind_startup *body;
+	struct sk_buff *skb;
+
+	body = wfx_emul_alloc_msg(HIF_IND_ID_STARTUP, 0, sizeof(*body), &skb);
+	if (!body)
+		return;
+	body->status = HIF_STATUS_SUCCESS;
+	body->num_inp_ch_bufs = cpu_to_le16(emul->num_bufs);
+	body->size_inp_ch_buf = cpu_to_le16(1616);
+	body->num_links_ap = 14;
+	body->num_interfaces = ARRAY_SIZE(emul->vif);
+	memcpy(body->mac_addr, emul->mac_addr, sizeof(body->mac_addr));
+	body->api_version_major = 3;
+	body->api_version_minor = 12;
+	body->firmware_major = 3;
+	body->firmware_minor = 12;
+	body->supported_rate_mask = cpu_to_le32(~0);
+	strscpy((char *)body->firmware_label, "emulated", sizeof(body->firmware_label));
+	wfx_emul_push_pending(emul, skb, 0, emul_cmd_latency_us);
+}
+
+static void wfx_emul_sram_write32(struct wfx_emul *emul, u32 addr, u32 val)
+{
+	if (addr == WFX_DCA_PUT) {
+		/* The emulated chip consumes the data immediately */
+		emul->dca_put = val;
+	} else if (addr == WFX_DCA_HOST_STATUS) {
+		switch (val) {
+		case HOST_READY:
+			emul->ncp_status = NCP_INFO_READY;
+			break;
+		case HOST_INFO_READ:
+			emul->ncp_status = NCP_READY;
+			break;
+		case HOST_UPLOAD_PENDING:
+			emul->ncp_status = NCP_DOWNLOAD_PENDING;
+			break;
+		case HOST_UPLOAD_COMPLETE:
+			emul->ncp_status = NCP_AUTH_OK;
+			break;
+		case HOST_OK_TO_JUMP:
+			wfx_emul_boot(emul);
+			break;
+		}
+	}
+}
+
+static void wfx_emul_sram_read(struct wfx_emul *emul, u8 *dst, size_t count)
+{
+	static const char label[] = "emulated bootloader";
+	__le32 val;
+
+	switch (emul->base_addr) {
+	case WFX_DCA_NCP_STATUS:
+		val = cpu_to_le32(emul->ncp_status);
+		break;
+	case WFX_DCA_GET:
+		val = cpu_to_le32(emul->dca_put);
+		break;
+	case WFX_STATUS_INFO:
+		val = cpu_to_le32(0x12345678);
+		break;
+	case WFX_BOOTLOADER_LABEL:
+		memcpy(dst, label, min(count, sizeof(label)));
+		return;
+	case WFX_PTE_INFO:
+		if (count > PTE_INFO_KEYSET_IDX)
+			dst[PTE_INFO_KEYSET_IDX] = WFX_EMUL_KEYSET;
+		return;
+	default:
+		return;
+	}
+	memcpy(dst, &val, min(count, sizeof(val)));
+}
+
+static void wfx_emul_reply(struct wfx_emul *emul, const struct wfx_hif_msg *req)
+{
+	const struct wfx_hif_req_read_mib *req_read_mib = (void *)req->body;
+	const struct wfx_hif_req_write_mib *req_write_mib = (void *)req->body;
+	const struct wfx_hif_req_start_scan_alt *req_scan = (void *)req->body;
+	const struct wfx_hif_req_join *req_join = (void *)req->body;
+	const struct wfx_hif_req_start *req_start = (void *)req->body;
+	const struct wfx_hif_mib_gl_set_multi_msg *multi_msg = (void *)req_write_mib->mib_data;
+	struct wfx_hif_cnf_read_mib *cnf_read_mib;
+	struct wfx_hif_ind_scan_cmpl *ind_scan;
+	struct wfx_emul_vif *vif = &emul->vif[req->interface % ARRAY_SIZE(emul->vif)];
+	struct sk_buff *skb, *ind = NULL;
+	__le32 *status;
+
+	switch (req->id) {
+	case HIF_REQ_ID_READ_MIB:
+		/* The values of the MIBs are not emulated */
+		cnf_read_mib = wfx_emul_alloc_msg(req->id, req->interface, sizeof(*cnf_read_mib),
+						  &skb);
+		if (!cnf_read_mib) {
+			emul->bufs_used--;
+			return;
+		}
+		cnf_read_mib->status = HIF_STATUS_UNKNOWN_REQUEST;
+		cnf_read_mib->mib_id = req_read_mib->mib_id;
+		goto send;
+	case HIF_REQ_ID_WRITE_MIB:
+		if (le16_to_cpu(req_write_mib->mib_id) == HIF_MIB_ID_GL_SET_MULTI_MSG)
+			emul->multi_tx_cnf = multi_msg->enable_multi_tx_conf;
+		break;
+	case HIF_REQ_ID_START_SCAN:
+		ind_scan = wfx_emul_alloc_msg(HIF_IND_ID_SCAN_CMPL, req->interface,
+					      sizeof(*ind_scan), &ind);
+		if (ind_scan)
+			ind_scan->num_channels_completed = req_scan->num_of_channels;
+		break;
+	case HIF_REQ_ID_SET_PM_MODE:
+		wfx_emul_alloc_msg(HIF_IND_ID_SET_PM_MODE_CMPL, req->interface,
+				   sizeof(struct wfx_hif_ind_set_pm_mode_cmpl), &ind);
+		break;
+	case HIF_REQ_ID_JOIN:
+		vif->active = true;
+		vif->channel = req_join->channel_number;
+		ether_addr_copy(vif->bssid, req_join->bssid);
+		break;
+	case HIF_REQ_ID_START:
+		vif->active = true;
+		vif->channel = req_start->channel_number;
+		ether_addr_copy(vif->bssid, emul->mac_addr[req->interface % ARRAY_SIZE(emul->vif)]);
+		break;
+	case HIF_REQ_ID_RESET:
+		vif->active = false;
+		break;
+	}
+
+	status = wfx_emul_alloc_msg(req->id, req->interface, sizeof(*status), &skb);
+	if (!status) {
+		kfree_skb(ind);
+		emul->bufs_used--;
+		return;
+	}
+	*status = HIF_STATUS_SUCCESS;
+send:
+	wfx_emul_push_pending(emul, skb, 1, emul_cmd_latency_us);
+	if (ind)
+		wfx_emul_push_pending(emul, ind, 0, emul_cmd_latency_us);
+}
+
+static void wfx_emul_request(struct wfx_emul *emul, const void *src, size_t count)
+{
+	const struct wfx_hif_msg *hif = src;
+	const struct wfx_hif_req_tx *req_tx = (void *)hif->body;
+	struct wfx_emul_tx *tx;
+
+	if (count < sizeof(*hif) || le16_to_cpu(hif->len) > count) {
+		emul->config_reg |= CFG_ERR_BUF_UNDERRUN;
+		return;
+	}
+	if (hif->encrypted) {
+		dev_warn_once(&emul->pdev->dev, "secure link is not emulated\n");
+		return;
+	}
+	if (hif->id == HIF_REQ_ID_SHUT_DOWN)
+		return;
+	if (emul->bufs_used >= emul->num_bufs) {
+		emul->config_reg |= CFG_ERR_BUF_OVERRUN;
+		emul->stats.num_overruns++;
+		return;
+	}
+	emul->bufs_used++;
+	emul->stats.num_req++;
+	if (hif->id != HIF_REQ_ID_TX) {
+		wfx_emul_reply(emul, hif);
+		return;
+	}
+	/* A buffer is used, so there is always room in tx[] */
+	tx = &emul->tx[(emul->tx_head + emul->tx_count) % ARRAY_SIZE(emul->tx)];
+	emul->tx_count++;
+	tx->packet_id = req_tx->packet_id;
+	tx->interface = hif->interface;
+	tx->txed_rate = req_tx->max_tx_rate;
+	tx->due = ktime_add_us(ktime_get(), emul_tx_latency_us);
+}
+
+static void wfx_emul_send_tx_cnf(struct wfx_emul *emul, ktime_t now)
+{
+	struct wfx_hif_cnf_multi_transmit *multi;
+	struct wfx_hif_cnf_tx *cnf;
+	struct wfx_emul_tx *tx;
+	struct sk_buff *skb;
+	int max = emul->multi_tx_cnf ? clamp(emul_multi_tx_cnf, 1U, 64U) : 1;
+	int i, num;
+
+	for (num = 0; num < min(emul->tx_count, max); num++)
+		if (ktime_after(emul->tx[(emul->tx_head + num) % ARRAY_SIZE(emul->tx)].due, now))
+			break;
+	if (!num)
+		return;
+	tx = &emul->tx[emul->tx_head];
+	if (num == 1) {
+		cnf = wfx_emul_alloc_msg(HIF_CNF_ID_TX, tx->interface, sizeof(*cnf), &skb);
+	} else {
+		multi = wfx_emul_alloc_msg(HIF_CNF_ID_MULTI_TRANSMIT, tx->interface,
+					   struct_size(multi, tx_conf_payload, num), &skb);
+		if (multi) {
+			multi->num_tx_confs = num;
+			emul->stats.num_multi_tx_cnf++;
+		}
+		cnf = multi ? multi->tx_conf_payload : NULL;
+	}
+	if (!cnf)
+		return;
+	for (i = 0; i < num; i++) {
+		tx = &emul->tx[emul->tx_head];
+		cnf[i].status = HIF_STATUS_SUCCESS;
+		cnf[i].packet_id = tx->packet_id;
+		cnf[i].txed_rate = tx->txed_rate;
+		cnf[i].media_delay = cpu_to_le32(emul_tx_latency_us);
+		emul->tx_head = (emul->tx_head + 1) % ARRAY_SIZE(emul->tx);
+		emul->tx_count--;
+	}
+	emul->stats.num_tx_cnf += num;
+	wfx_emul_cb(skb)->num_release = num;
+	wfx_emul_push_rx(emul, skb);
+}
+
+/* Broadcast data frame from the BSS */
+static void wfx_emul_send_rx(struct wfx_emul *emul, int if_id)
+{
+	static const u8 llc_header[] = { 0xAA, 0xAA, 0x03, 0x00, 0x00, 0x00, 0x88, 0xB5 };
+	struct ieee80211_hdr_3addr *frame;
+	struct wfx_hif_ind_rx *body;
+	struct sk_buff *skb;
+	size_t len = clamp_t(size_t, emul_rx_len, sizeof(*frame) + sizeof(llc_header),
+			     IEEE80211_MAX_DATA_LEN);
+
+	body = wfx_emul_alloc_msg(HIF_IND_ID_RX, if_id, sizeof(*body) + len, &skb);
+	if (!body)
+		return;
+	body->status = HIF_STATUS_SUCCESS;
+	body->channel_number = emul->vif[if_id].channel;
+	body->rxed_rate = 21; /* MCS7 */
+	body->rcpi_rssi = 100; /* -60dBm */
+	body->match_bc_addr = 1;
+	frame = (struct ieee80211_hdr_3addr *)(body + 1);
+	frame->frame_control = cpu_to_le16(IEEE80211_FTYPE_DATA | IEEE80211_STYPE_DATA |
+					   IEEE80211_FCTL_FROMDS);
+	eth_broadcast_addr(frame->addr1);
+	/* frame is not aligned, so ether_addr_copy() cannot be used */
+	memcpy(frame->addr2, emul->vif[if_id].bssid, ETH_ALEN);
+	memcpy(frame->addr3, emul->vif[if_id].bssid, ETH_ALEN);
+	frame->seq_ctrl = cpu_to_le16(emul->rx_seqnum++ << 4);
+	memcpy(frame + 1, llc_header, sizeof(llc_header));
+	emul->stats.num_ind_rx++;
+	wfx_emul_push_rx(emul, skb);
+}
+
+static void wfx_emul_gen_rx(struct wfx_emul *emul, ktime_t now)
+{
+	unsigned int rate = emul_rx_rate;
+	s64 period;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(emul->vif); i++)
+		if (emul->vif[i].active)
+			break;
+	if (!rate || i == ARRAY_SIZE(emul->vif)) {
+		emul->next_rx = 0;
+		return;
+	}
+	period = div_u64(NSEC_PER_SEC, rate);
+	if (!emul->next_rx)
+		emul->next_rx = ktime_add_ns(now, period);
+	for (j = 0; j < WFX_EMUL_RX_BURST && !ktime_after(emul->next_rx, now); j++) {
+		if (skb_queue_len(&emul->rx_queue) < WFX_EMUL_MAX_RX)
+			wfx_emul_send_rx(emul, i);
+		else
+			emul->stats.num_rx_drops++;
+		emul->next_rx = ktime_add_ns(emul->next_rx, period);
+	}
+	/* Do not try to catch up if the system is too late */
+	if (!ktime_after(emul->next_rx, now))
+		emul->next_rx = ktime_add_ns(now, period);
+}
+
+static void wfx_emul_event_work(struct work_struct *work)
+{
+	struct wfx_emul *emul = container_of(work, struct wfx_emul, event_work);
+	ktime_t now = ktime_get();
+	struct sk_buff *skb;
+	bool was_empty, raise_irq;
+	int num_tx;
+
+	mutex_lock(&emul->lock);
+	was_empty = skb_queue_empty(&emul->rx_queue);
+	while ((skb = skb_peek(&emul->pending)) && !ktime_after(wfx_emul_cb(skb)->due, now)) {
+		__skb_unlink(skb, &emul->pending);
+		wfx_emul_push_rx(emul, skb);
+	}
+	do {
+		num_tx = emul->tx_count;
+		wfx_emul_send_tx_cnf(emul, now);
+	} while (emul->tx_count && emul->tx_count != num_tx);
+	wfx_emul_gen_rx(emul, now);
+	raise_irq = was_empty && !skb_queue_empty(&emul->rx_queue) && emul->irq_enabled;
+	wfx_emul_arm_timer(emul);
+	mutex_unlock(&emul->lock);
+	if (raise_irq)
+		wfx_bh_request_rx(emul->core);
+}
+
+static enum hrtimer_restart wfx_emul_timer(struct hrtimer *timer)
+{
+	struct wfx_emul *emul = container_of(timer, struct wfx_emul, timer);
+
+	queue_work(system_highpri_wq, &emul->event_work);
+	return HRTIMER_NORESTART;
+}
+
+static void wfx_emul_read_queue(struct wfx_emul *emul, u8 *dst, size_t count)
+{
+	struct sk_buff *skb = __skb_dequeue(&emul->rx_queue);
+
+	if (count < 2)
+		return;
+	if (!skb) {
+		emul->config_reg |= CFG_ERR_HOST_NO_OUT_QUEUE;
+		return;
+	}
+	if (skb->len > count - 2)
+		emul->config_reg |= CFG_ERR_DATA_OUT_TOO_LARGE;
+	memcpy(dst, skb->data, min_t(size_t, skb->len, count - 2));
+	put_unaligned_le16(wfx_emul_control_reg(emul), dst + count - 2);
+	emul->bufs_used -= wfx_emul_cb(skb)->num_release;
+	if (wfx_emul_cb(skb)->num_release)
+		emul->stats.num_cnf++;
+	kfree_skb(skb);
+}
+
+static int wfx_emul_copy_from_io(void *priv, unsigned int addr, void *dst, size_t count)
+{
+	struct wfx_emul *emul = priv;
+	__le32 val = 0;
+
+	memset(dst, 0, count);
+	mutex_lock(&emul->lock);
+	switch (addr) {
+	case WFX_REG_CONFIG:
+		val = cpu_to_le32(emul->config_reg);
+		break;
+	case WFX_REG_CONTROL:
+		val = cpu_to_le32(wfx_emul_control_reg(emul));
+		break;
+	case WFX_REG_IN_OUT_QUEUE:
+		wfx_emul_read_queue(emul, dst, count);
+		break;
+	case WFX_REG_SRAM_DPORT:
+		wfx_emul_sram_read(emul, dst, count);
+		break;
+	}
+	mutex_unlock(&emul->lock);
+	if (val)
+		memcpy(dst, &val, min(count, sizeof(val)));
+	return 0;
+}
+
+static int wfx_emul_copy_to_io(void *priv, unsigned int addr, const void *src, size_t count)
+{
+	struct wfx_emul *emul = priv;
+	u32 val = count >= sizeof(u32) ? get_unaligned_le32(src) : 0;
+
+	mutex_lock(&emul->lock);
+	switch (addr) {
+	case WFX_REG_CONFIG:
+		/* Prefetch is immediate */
+		val &= ~(CFG_PREFETCH_AHB | CFG_PREFETCH_SRAM);
+		val &= ~(CFG_DEVICE_ID_MAJOR | CFG_DEVICE_ID_RESERVED | CFG_DEVICE_ID_TYPE);
+		emul->config_reg = val | WFX_EMUL_CONFIG_REG;
+		break;
+	case WFX_REG_CONTROL:
+		emul->control_reg = val & CTRL_WLAN_WAKEUP;
+		break;
+	case WFX_REG_BASE_ADDR:
+		emul->base_addr = val;
+		break;
+	case WFX_REG_SRAM_DPORT:
+		/* Content of the firmware is ignored */
+		if (count == sizeof(u32))
+			wfx_emul_sram_write32(emul, emul->base_addr, val);
+		break;
+	case WFX_REG_IN_OUT_QUEUE:
+		wfx_emul_request(emul, src, count);
+		break;
+	}
+	wfx_emul_arm_timer(emul);
+	mutex_unlock(&emul->lock);
+	return 0;
+}
+
+static int wfx_emul_irq_subscribe(void *priv)
+{
+	struct wfx_emul *emul = priv;
+	bool raise_irq;
+
+	mutex_lock(&emul->lock);
+	emul->irq_enabled = true;
+	raise_irq = !skb_queue_empty(&emul->rx_queue);
+	mutex_unlock(&emul->lock);
+	if (raise_irq)
+		wfx_bh_request_rx(emul->core);
+	return 0;
+}
+
+static int wfx_emul_irq_unsubscribe(void *priv)
+{
+	struct wfx_emul *emul = priv;
+
+	mutex_lock(&emul->lock);
+	emul->irq_enabled = false;
+	mutex_unlock(&emul->lock);
+	flush_work(&emul->event_work);
+	return 0;
+}
+
+static void wfx_emul_lock(void *priv)
+{
+}
+
+static void wfx_emul_unlock(void *priv)
+{
+}
+
+static size_t wfx_emul_align_size(void *priv, size_t size)
+{
+	return ALIGN(size, 4);
+}
+
+static int wfx_emul_reset(void *priv)
+{
+	struct wfx_emul *emul = priv;
+
+	mutex_lock(&emul->lock);
+	wfx_emul_reset_state(emul);
+	mutex_unlock(&emul->lock);
+	return 0;
+}
+
+static const struct wfx_hwbus_ops wfx_emul_hwbus_ops = {
+	.copy_from_io = wfx_emul_copy_from_io,
+	.copy_to_io = wfx_emul_copy_to_io,
+	.irq_subscribe = wfx_emul_irq_subscribe,
+	.irq_unsubscribe = wfx_emul_irq_unsubscribe,
+	.lock = wfx_emul_lock,
+	.unlock = wfx_emul_unlock,
+	.align_size = wfx_emul_align_size,
+	.reset = wfx_emul_reset,
+};
+
+/* There is no file for the emulated chip. So, populate the cache of the firmwares with a fake
+ * image and an empty PDS.
+ */
+static void wfx_emul_fill_fw_cache(struct device *dev)
+{
+	static const u8 pds[] = { 0x02, 0x00, '{', '}' };
+	size_t len = 8 + 64 + 8 + WFX_EMUL_FW_LEN; /* keyset, signature, hash and image */
+	struct wfx_fw_cache_entry *entry;
+	u8 *image;
+
+	image = kzalloc(len, GFP_KERNEL);
+	if (!image)
+		return;
+	snprintf((char *)image, 9, "KEYSET%02X", WFX_EMUL_KEYSET);
+	entry = wfx_fw_cache_add(pdata_emul.file_fw, WFX_EMUL_KEYSET, image, len, 8, 0);
+	kfree(image);
+	if (!entry)
+		dev_warn(dev, "firmware cache is disabled, %s_%02X.sec has to be provided\n",
+			 pdata_emul.file_fw, WFX_EMUL_KEYSET);
+	wfx_fw_cache_put(entry);
+	wfx_fw_cache_put(wfx_fw_cache_add(pdata_emul.file_pds, WFX_FW_CACHE_PDS,
+					  pds, sizeof(pds), 0, 0));
+}
+
+static void wfx_emul_stop(struct wfx_emul *emul)
+{
+	mutex_lock(&emul->lock);
+	emul->stopped = true;
+	mutex_unlock(&emul->lock);
+	hrtimer_cancel(&emul->timer);
+	cancel_work_sync(&emul->event_work);
+	__skb_queue_purge(&emul->pending);
+	__skb_queue_purge(&emul->rx_queue);
+	mutex_destroy(&emul->lock);
+}
+
+static int wfx_emul_probe(struct platform_device *pdev)
+{
+	struct wfx_emul *emul;
+	int ret;
+
+	emul = devm_kzalloc(&pdev->dev, sizeof(*emul), GFP_KERNEL);
+	if (!emul)
+		return -ENOMEM;
+	emul->pdev = pdev;
+	mutex_init(&emul->lock);
+	skb_queue_head_init(&emul->pending);
+	skb_queue_head_init(&emul->rx_queue);
+	hrtimer_init(&emul->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	emul->timer.function = wfx_emul_timer;
+	INIT_WORK(&emul->event_work, wfx_emul_event_work);
+	emul->num_bufs = clamp(emul_num_bufs, 1U, (unsigned int)WFX_EMUL_MAX_BUFS);
+	eth_random_addr(emul->mac_addr[0]);
+	eth_random_addr(emul->mac_addr[1]);
+	wfx_emul_reset_state(emul);
+	platform_set_drvdata(pdev, emul);
+
+	wfx_emul_fill_fw_cache(&pdev->dev);
+	emul->core = wfx_init_common(&pdev->dev, &pdata_emul, &wfx_emul_hwbus_ops, emul);
+	if (!emul->core) {
+		ret = -EIO;
+		goto err;
+	}
+	ret = wfx_probe(emul->core);
+	if (ret)
+		goto err;
+	return 0;
+
+err:
+	wfx_emul_stop(emul);
+	return ret;
+}
+
+static int wfx_emul_remove(struct platform_device *pdev)
+{
+	struct wfx_emul *emul = platform_get_drvdata(pdev);
+
+	wfx_release(emul->core);
+	wfx_emul_stop(emul);
+	dev_info(&pdev->dev, "emulated chip received %u requests (%u overruns) and sent %u confirmations, %u TX confirmations (%u grouped messages), %u RX indications (%u dropped)\n",
+		 emul->stats.num_req, emul->stats.num_overruns, emul->stats.num_cnf,
+		 emul->stats.num_tx_cnf, emul->stats.num_multi_tx_cnf, emul->stats.num_ind_rx,
+		 emul->stats.num_rx_drops);
+	return 0;
+}
+
+static struct platform_driver wfx_emul_driver = {
+	.probe = wfx_emul_probe,
+	.remove = wfx_emul_remove,
+	.driver = {
+		.name = "wfx-emul",
+#if (KERNEL_VERSION(4, 2, 0) <= LINUX_VERSION_CODE)
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
+	},
+};
+
+void wfx_emul_unregister(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(wfx_emul_devices); i++) {
+		if (wfx_emul_devices[i])
+			platform_device_unregister(wfx_emul_devices[i]);
+		wfx_emul_devices[i] = NULL;
+	}
+	platform_driver_unregister(&wfx_emul_driver);
+}
+
+int wfx_emul_register(void)
+{
+	struct platform_device *pdev;
+	int ret, i;
+
+	ret = platform_driver_register(&wfx_emul_driver);
+	if (ret)
+		return ret;
+	for (i = 0; i < min_t(int, emul_num_devices, ARRAY_SIZE(wfx_emul_devices)); i++) {
+		pdev = platform_device_register_simple("wfx-emul", i, NULL, 0);
+		if (IS_ERR(pdev)) {
+			wfx_emul_unregister();
+			return PTR_ERR(pdev);
+		}
+		wfx_emul_devices[i] = pdev;
+	}
+	return 0;
+}
@@ -306,5 +306,8 @@ struct sdio_driver wfx_sdio_driver = {
 	.drv = {
 		.owner = THIS_MODULE,
 		.of_match_table = wfx_sdio_of_match,
+#if (KERNEL_VERSION(4, 2, 0) <= LINUX_VERSION_CODE)
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
 	}
 };
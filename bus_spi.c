@@ -62,6 +62,7 @@ struct wfx_spi_priv {
 	struct spi_device *func;
 	struct wfx_dev *core;
 	struct gpio_desc *gpio_reset;
+	bool reset_inverted;
 	bool need_swab;
 };
 
@@ -255,6 +256,26 @@ static size_t wfx_spi_align_size(void *priv, size_t size)
 	return ALIGN(size, 4);
 }
 
+static int wfx_spi_reset(void *priv)
+{
+	struct wfx_spi_priv *bus = priv;
+
+	if (!bus->gpio_reset)
+		return -EOPNOTSUPP;
+#if (KERNEL_VERSION(5, 5, 5) > LINUX_VERSION_CODE)
+	gpiod_set_value_cansleep(bus->gpio_reset, bus->reset_inverted ? 0 : 1);
+	usleep_range(100, 150);
+	gpiod_set_value_cansleep(bus->gpio_reset, bus->reset_inverted ? 1 : 0);
+#else
+	/* Polarity has been fixed during probe with gpiod_toggle_active_low() */
+	gpiod_set_value_cansleep(bus->gpio_reset, 1);
+	usleep_range(100, 150);
+	gpiod_set_value_cansleep(bus->gpio_reset, 0);
+#endif
+	usleep_range(2000, 2500);
+	return 0;
+}
+
 static const struct wfx_hwbus_ops wfx_spi_hwbus_ops = {
 	.copy_from_io    = wfx_spi_copy_from_io,
 	.copy_to_io      = wfx_spi_copy_to_io,
@@ -263,6 +284,7 @@ static const struct wfx_hwbus_ops wfx_spi_hwbus_ops = {
 	.lock            = wfx_spi_lock,
 	.unlock          = wfx_spi_unlock,
 	.align_size      = wfx_spi_align_size,
+	.reset           = wfx_spi_reset,
 };
 
 static int wfx_spi_probe(struct spi_device *func)
@@ -301,24 +323,18 @@ static int wfx_spi_probe(struct spi_device *func)
 	bus->gpio_reset = devm_gpiod_get_optional(&func->dev, "reset", GPIOD_OUT_LOW);
 	if (IS_ERR(bus->gpio_reset))
 		return PTR_ERR(bus->gpio_reset);
+	bus->reset_inverted = pdata->reset_inverted;
 	if (!bus->gpio_reset) {
 		dev_warn(&func->dev, "gpio reset is not defined, trying to load firmware anyway\n");
 	} else {
 #if (KERNEL_VERSION(4, 19, 0) <= LINUX_VERSION_CODE)
 		gpiod_set_consumer_name(bus->gpio_reset, "wfx reset");
 #endif
-#if (KERNEL_VERSION(5, 5, 5) > LINUX_VERSION_CODE)
-		gpiod_set_value_cansleep(bus->gpio_reset, pdata->reset_inverted ? 0 : 1);
-		usleep_range(100, 150);
-		gpiod_set_value_cansleep(bus->gpio_reset, pdata->reset_inverted ? 1 : 0);
-#else
+#if (KERNEL_VERSION(5, 5, 5) <= LINUX_VERSION_CODE)
 		if (pdata->reset_inverted)
 			gpiod_toggle_active_low(bus->gpio_reset);
-		gpiod_set_value_cansleep(bus->gpio_reset, 1);
-		usleep_range(100, 150);
-		gpiod_set_value_cansleep(bus->gpio_reset, 0);
 #endif
-		usleep_range(2000, 2500);
+		wfx_spi_reset(bus);
 	}
 
 	bus->core = wfx_init_common(&func->dev, pdata, &wfx_spi_hwbus_ops, bus);
@@ -366,6 +382,9 @@ struct spi_driver wfx_spi_driver = {
 	.driver = {
 		.name = "wfx-spi",
 		.of_match_table = of_match_ptr(wfx_spi_of_match),
+#if (KERNEL_VERSION(4, 2, 0) <= LINUX_VERSION_CODE)
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
 	},
 	.id_table = wfx_spi_id,
 	.probe = wfx_spi_probe,
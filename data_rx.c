@@ -13,6 +13,7 @@
 #include "wfx.h"
 #include "bh.h"
 #include "sta.h"
+#include "scan.h"
 
 static void wfx_rx_handle_ba(struct wfx_vif *wvif, struct ieee80211_mgmt *mgmt)
 {
@@ -80,6 +81,15 @@ void wfx_rx_cb(struct wfx_vif *wvif, const struct wfx_hif_ind_rx *arg, struct sk
 	if (arg->encryp)
 		hdr->flag |= RX_FLAG_DECRYPTED;
 
+	if (ieee80211_is_beacon(frame->frame_control) ||
+	    ieee80211_is_probe_resp(frame->frame_control))
+		wfx_scan_bss_seen(wvif->wdev, arg->channel_number);
+	if (ieee80211_is_data_qos(frame->frame_control))
+		wfx_ps_adapt_packet(wvif, ieee802_1d_to_ac[*ieee80211_get_qos_ctl(frame) &
+							  IEEE80211_QOS_CTL_TAG1D_MASK]);
+	else if (ieee80211_is_data(frame->frame_control))
+		wfx_ps_adapt_packet(wvif, IEEE80211_AC_BE);
+
 	/* Block ack negotiation is offloaded by the firmware. However, re-ordering must be done by
 	 * the mac80211.
 	 */
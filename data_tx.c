@@ -52,10 +52,9 @@ static int wfx_get_hw_rate(struct wfx_dev *wdev, const struct ieee80211_tx_rate
 
 /* TX policy cache implementation */
 
-static void wfx_tx_policy_build(struct wfx_vif *wvif, struct wfx_tx_policy *policy,
+static void wfx_tx_policy_build(struct wfx_dev *wdev, struct wfx_tx_policy *policy,
 				struct ieee80211_tx_rate *rates)
 {
-	struct wfx_dev *wdev = wvif->wdev;
 	int i, rateid;
 	u8 count;
 
@@ -114,7 +113,7 @@ static int wfx_tx_policy_get(struct wfx_vif *wvif, struct ieee80211_tx_rate *rat
 	struct wfx_tx_policy wanted;
 	struct wfx_tx_policy *entry;
 
-	wfx_tx_policy_build(wvif, &wanted, rates);
+	wfx_tx_policy_build(wvif->wdev, &wanted, rates);
 
 	spin_lock_bh(&cache->lock);
 	if (list_empty(&cache->free)) {
@@ -189,9 +188,8 @@ void wfx_tx_policy_upload_work(struct work_struct *work)
 	wfx_tx_unlock(wvif->wdev);
 }
 
-void wfx_tx_policy_init(struct wfx_vif *wvif)
+static void wfx_tx_policy_cache_init(struct wfx_tx_policy_cache *cache)
 {
-	struct wfx_tx_policy_cache *cache = &wvif->tx_policy_cache;
 	int i;
 
 	memset(cache, 0, sizeof(*cache));
@@ -204,6 +202,11 @@ void wfx_tx_policy_init(struct wfx_vif *wvif)
 		list_add(&cache->cache[i].link, &cache->free);
 }
 
+void wfx_tx_policy_init(struct wfx_vif *wvif)
+{
+	wfx_tx_policy_cache_init(&wvif->tx_policy_cache);
+}
+
 /* Tx implementation */
 
 static bool wfx_is_action_back(struct ieee80211_hdr *hdr)
@@ -362,6 +365,7 @@ static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct
 	tx_priv = (struct wfx_tx_priv *)tx_info->rate_driver_data;
 	tx_priv->icv_size = wfx_tx_get_icv_len(hw_key);
 	tx_priv->vif_id = wvif->id;
+	tx_priv->queue_timestamp = ktime_get();
 
 	/* Fill hif_msg */
 	WARN(skb_headroom(skb) < wmsg_len, "not enough space in skb");
@@ -420,8 +424,10 @@ static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct
 
 	/* Auxiliary operations */
 	wfx_tx_queues_put(wvif, skb);
+	if (ieee80211_is_data(hdr->frame_control))
+		wfx_ps_adapt_packet(wvif, skb_get_queue_mapping(skb));
 	if (tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM)
-		schedule_work(&wvif->update_tim_work);
+		wfx_update_tim_request(wvif);
 	wfx_bh_request_tx(wvif->wdev);
 	return 0;
 }
@@ -513,6 +519,22 @@ static void wfx_tx_fill_rates(struct wfx_dev *wdev, struct ieee80211_tx_info *tx
 		dev_dbg(wdev->dev, "%d more retries than expected\n", tx_count);
 }
 
+static void wfx_tx_update_latency(struct wfx_vif *wvif, struct sk_buff *skb,
+				  const struct wfx_hif_cnf_tx *arg)
+{
+	struct wfx_queue *queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
+	const struct wfx_tx_priv *tx_priv = wfx_skb_tx_priv(skb);
+	ktime_t now = ktime_get();
+
+	spin_lock(&queue->latency_lock);
+	wfx_hist_add(&queue->latency.host,
+		     ktime_us_delta(tx_priv->xmit_timestamp, tx_priv->queue_timestamp));
+	wfx_hist_add(&queue->latency.fw, ktime_us_delta(now, tx_priv->xmit_timestamp));
+	wfx_hist_add(&queue->latency.media, le32_to_cpu(arg->media_delay));
+	wfx_hist_add(&queue->latency.total, ktime_us_delta(now, tx_priv->queue_timestamp));
+	spin_unlock(&queue->latency_lock);
+}
+
 void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg)
 {
 	const struct wfx_tx_priv *tx_priv;
@@ -534,6 +556,7 @@ void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg)
 		return;
 
 	/* Note that wfx_pending_get_pkt_us_delay() get data from tx_info */
+	wfx_tx_update_latency(wvif, skb, arg);
 	_trace_tx_stats(arg, skb, wfx_pending_get_pkt_us_delay(wdev, skb));
 	wfx_tx_fill_rates(wdev, tx_info, arg);
 	skb_trim(skb, skb->len - tx_priv->icv_size);
@@ -559,7 +582,7 @@ void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg)
 		WARN(!arg->requeue, "incoherent status and result_flags");
 		if (tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM) {
 			wvif->after_dtim_tx_allowed = false; /* DTIM period elapsed */
-			schedule_work(&wvif->update_tim_work);
+			wfx_update_tim_request(wvif);
 		}
 		tx_info->flags |= IEEE80211_TX_STAT_TX_FILTERED;
 	}
@@ -578,7 +601,7 @@ static void wfx_flush_vif(struct wfx_vif *wvif, u32 queues, struct sk_buff_head
 		if (dropped)
 			wfx_tx_queue_drop(wvif, queue, dropped);
 	}
-	if (wvif->wdev->chip_frozen)
+	if (READ_ONCE(wvif->wdev->chip_frozen))
 		return;
 	for (i = 0; i < IEEE80211_NUM_ACS; i++) {
 		if (!(BIT(i) & queues))
@@ -607,7 +630,7 @@ void wfx_flush(struct ieee80211_hw *hw, struct ieee80211_vif *vif, u32 queues, b
 			wfx_flush_vif(wvif, queues, drop ? &dropped : NULL);
 	}
 	wfx_tx_flush(wdev);
-	if (wdev->chip_frozen)
+	if (READ_ONCE(wdev->chip_frozen))
 		wfx_pending_drop(wdev, &dropped);
 	while ((skb = skb_dequeue(&dropped)) != NULL) {
 		wvif = wfx_skb_wvif(wdev, skb);
@@ -615,3 +638,7 @@ void wfx_flush(struct ieee80211_hw *hw, struct ieee80211_vif *vif, u32 queues, b
 		wfx_skb_dtor(wvif, skb);
 	}
 }
+
+#ifdef CONFIG_WFX_KUNIT_TEST
+#include "data_tx_test.c"
+#endif
@@ -34,6 +34,7 @@ struct wfx_tx_policy_cache {
 };
 
 struct wfx_tx_priv {
+	ktime_t queue_timestamp;
 	ktime_t xmit_timestamp;
 	unsigned char icv_size;
 	unsigned char vif_id;
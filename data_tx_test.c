@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests of the processing of the rates of the transmitted frames.
+ *
+ * Copyright (c) 2017-2020, Silicon Laboratories, Inc.
+ */
+#include <kunit/test.h>
+
+/* This file is included by data_tx.c, so the tests can reach its static functions */
+
+#define WFX_TEST_LOOPS 10000
+#define WFX_TEST_RATES 16
+
+/* Same hardware values than the 2.4GHz band declared by main.c */
+static struct ieee80211_rate wfx_test_rates[] = {
+	{ .bitrate = 10,  .hw_value = 0 },
+	{ .bitrate = 20,  .hw_value = 1 },
+	{ .bitrate = 55,  .hw_value = 2 },
+	{ .bitrate = 110, .hw_value = 3 },
+	{ .bitrate = 60,  .hw_value = 6 },
+	{ .bitrate = 90,  .hw_value = 7 },
+	{ .bitrate = 120, .hw_value = 8 },
+	{ .bitrate = 180, .hw_value = 9 },
+	{ .bitrate = 240, .hw_value = 10 },
+	{ .bitrate = 360, .hw_value = 11 },
+	{ .bitrate = 480, .hw_value = 12 },
+	{ .bitrate = 540, .hw_value = 13 },
+};
+
+static struct ieee80211_supported_band wfx_test_band_2ghz = {
+	.band = NL80211_BAND_2GHZ,
+	.bitrates = wfx_test_rates,
+	.n_bitrates = ARRAY_SIZE(wfx_test_rates),
+};
+
+/* wfx_tx_policy_build() only needs the bands of the device */
+static int wfx_data_tx_test_init(struct kunit *test)
+{
+	struct wfx_dev *wdev;
+
+	wdev = kunit_kzalloc(test, sizeof(*wdev), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, wdev);
+	wdev->hw = kunit_kzalloc(test, sizeof(*wdev->hw), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, wdev->hw);
+	wdev->hw->wiphy = kunit_kzalloc(test, sizeof(*wdev->hw->wiphy), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, wdev->hw->wiphy);
+	wdev->hw->wiphy->bands[NL80211_BAND_2GHZ] = &wfx_test_band_2ghz;
+	test->priv = wdev;
+	return 0;
+}
+
+/* Rate sets as minstrel produces them: not always sorted, not always complete */
+static void wfx_test_gen_rates(struct ieee80211_tx_rate rates[][IEEE80211_TX_MAX_RATES], int num)
+{
+	int i, j;
+
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < IEEE80211_TX_MAX_RATES; j++) {
+			rates[i][j].idx = (i * 5 + j * 3) % 8;
+			rates[i][j].count = 1 + (i + j) % 4;
+			rates[i][j].flags = i % 2 ? IEEE80211_TX_RC_MCS : 0;
+		}
+		if (i % 4 == 3)
+			rates[i][IEEE80211_TX_MAX_RATES - 1].idx = -1;
+	}
+}
+
+/* Rates must be in descending order and end with the lowest rate if there is room for it */
+static bool wfx_test_rates_valid(const struct ieee80211_tx_rate *rates)
+{
+	int i;
+
+	for (i = 1; i < IEEE80211_TX_MAX_RATES && rates[i].idx >= 0; i++)
+		if (rates[i].idx > rates[i - 1].idx || rates[i].count > 15)
+			return false;
+	return rates[0].count <= 15 && (i == IEEE80211_TX_MAX_RATES || !rates[i - 1].idx);
+}
+
+static void wfx_test_fixup_rates(struct kunit *test)
+{
+	struct ieee80211_tx_rate rates[IEEE80211_TX_MAX_RATES] = {
+		{ .idx = 5, .count = 3 }, { .idx = 7, .count = 2 }, { .idx = 2, .count = 1 },
+		{ .idx = -1 },
+	};
+
+	wfx_tx_fixup_rates(rates);
+	/* The higher rate is merged in the previous one and the lowest rate is appended */
+	KUNIT_EXPECT_EQ(test, rates[0].idx, 5);
+	KUNIT_EXPECT_EQ(test, rates[0].count, 5);
+	KUNIT_EXPECT_EQ(test, rates[1].idx, 2);
+	KUNIT_EXPECT_EQ(test, rates[1].count, 1);
+	KUNIT_EXPECT_EQ(test, rates[2].idx, 0);
+	KUNIT_EXPECT_EQ(test, rates[2].count, 8);
+	KUNIT_EXPECT_EQ(test, rates[3].idx, -1);
+}
+
+static void wfx_test_fixup_rates_perf(struct kunit *test)
+{
+	struct ieee80211_tx_rate rates[WFX_TEST_RATES][IEEE80211_TX_MAX_RATES];
+	struct ieee80211_tx_rate tmp[IEEE80211_TX_MAX_RATES];
+	int i, errors = 0;
+	ktime_t start;
+	s64 delta;
+
+	wfx_test_gen_rates(rates, WFX_TEST_RATES);
+	start = ktime_get();
+	for (i = 0; i < WFX_TEST_LOOPS; i++) {
+		memcpy(tmp, rates[i % WFX_TEST_RATES], sizeof(tmp));
+		wfx_tx_fixup_rates(tmp);
+	}
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	for (i = 0; i < WFX_TEST_RATES; i++) {
+		wfx_tx_fixup_rates(rates[i]);
+		if (!wfx_test_rates_valid(rates[i]))
+			errors++;
+	}
+	KUNIT_EXPECT_EQ_MSG(test, errors, 0, "invalid rate sets");
+	kunit_info(test, "fixup: %lld ns/op\n", div_s64(delta, WFX_TEST_LOOPS));
+}
+
+static void wfx_test_policy_build(struct kunit *test)
+{
+	struct ieee80211_tx_rate rates[IEEE80211_TX_MAX_RATES] = {
+		{ .idx = 7, .count = 3, .flags = IEEE80211_TX_RC_MCS },
+		{ .idx = 3, .count = 4 },
+		{ .idx = 0, .count = 8 },
+		{ .idx = -1 },
+	};
+	struct wfx_dev *wdev = test->priv;
+	struct wfx_tx_policy policy;
+
+	wfx_tx_policy_build(wdev, &policy, rates);
+	/* Two retry counts per byte, indexed by the hardware value of the rate */
+	KUNIT_EXPECT_EQ(test, policy.rates[(7 + 14) / 2], 3 << 4);
+	KUNIT_EXPECT_EQ(test, policy.rates[3 / 2], 4 << 4);
+	KUNIT_EXPECT_EQ(test, policy.rates[0], 8);
+}
+
+/* Lookup done for each frame sent once the policy cache is full */
+static void wfx_test_policy_cache(struct kunit *test)
+{
+	struct ieee80211_tx_rate rates[WFX_TEST_RATES][IEEE80211_TX_MAX_RATES];
+	struct wfx_dev *wdev = test->priv;
+	struct wfx_tx_policy_cache *cache;
+	int cached[WFX_TEST_RATES];
+	struct wfx_tx_policy wanted;
+	struct wfx_tx_policy *entry;
+	int i, hits = 0;
+	ktime_t start;
+	s64 delta;
+
+	cache = kunit_kzalloc(test, sizeof(*cache), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, cache);
+	wfx_tx_policy_cache_init(cache);
+	wfx_test_gen_rates(rates, WFX_TEST_RATES);
+	for (i = 0; i < WFX_TEST_RATES; i++) {
+		wfx_tx_fixup_rates(rates[i]);
+		wfx_tx_policy_build(wdev, &wanted, rates[i]);
+		cached[i] = wfx_tx_policy_find(cache, &wanted);
+		if (cached[i] >= 0 || list_empty(&cache->free))
+			continue;
+		entry = list_entry(cache->free.prev, struct wfx_tx_policy, link);
+		memcpy(entry->rates, wanted.rates, sizeof(entry->rates));
+		list_move(&entry->link, &cache->used);
+		cached[i] = entry - cache->cache;
+	}
+	start = ktime_get();
+	for (i = 0; i < WFX_TEST_LOOPS; i++) {
+		wfx_tx_policy_build(wdev, &wanted, rates[i % WFX_TEST_RATES]);
+		if (wfx_tx_policy_find(cache, &wanted) >= 0)
+			hits++;
+	}
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	for (i = 0; i < WFX_TEST_RATES; i++) {
+		wfx_tx_policy_build(wdev, &wanted, rates[i]);
+		KUNIT_EXPECT_EQ(test, wfx_tx_policy_find(cache, &wanted), cached[i]);
+	}
+	kunit_info(test, "policy lookup (%zu entries): %lld ns/op, %d%% hits\n",
+		   ARRAY_SIZE(cache->cache), div_s64(delta, WFX_TEST_LOOPS),
+		   hits * 100 / WFX_TEST_LOOPS);
+}
+
+static struct kunit_case wfx_data_tx_test_cases[] = {
+	KUNIT_CASE(wfx_test_fixup_rates),
+	KUNIT_CASE(wfx_test_fixup_rates_perf),
+	KUNIT_CASE(wfx_test_policy_build),
+	KUNIT_CASE(wfx_test_policy_cache),
+	{ }
+};
+
+static struct kunit_suite wfx_data_tx_test_suite = {
+	.name = "wfx-data-tx",
+	.init = wfx_data_tx_test_init,
+	.test_cases = wfx_data_tx_test_cases,
+};
+kunit_test_suite(wfx_data_tx_test_suite);
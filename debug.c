@@ -19,6 +19,7 @@
 #include "wfx.h"
 #include "sta.h"
 #include "main.h"
+#include "fwio.h"
 #include "hif_tx.h"
 #include "hif_tx_mib.h"
 
@@ -58,6 +59,35 @@ static const struct file_operations __fops = {                          \
 }
 #endif
 
+/* Like DEFINE_SHOW_ATTRIBUTE(), but any write to the file calls __name_trigger() (to reset
+ * statistics or to run an action). The content written is ignored.
+ */
+#define DEFINE_SHOW_TRIGGER_ATTRIBUTE(__name) \
+static int __name ## _open(struct inode *inode, struct file *file)      \
+{                                                                       \
+	return single_open(file, __name ## _show, inode->i_private);    \
+}                                                                       \
+                                                                        \
+static ssize_t __name ## _write(struct file *file, const char __user *user_buf, \
+				size_t count, loff_t *ppos)             \
+{                                                                       \
+	struct wfx_dev *wdev = ((struct seq_file *)file->private_data)->private; \
+	int ret;                                                        \
+                                                                        \
+	ret = __name ## _trigger(wdev);                                 \
+	if (ret)                                                        \
+		return ret;                                             \
+	return count;                                                   \
+}                                                                       \
+                                                                        \
+static const struct file_operations __name ## _fops = {                 \
+	.open    = __name ## _open,                                     \
+	.read    = seq_read,                                            \
+	.write   = __name ## _write,                                    \
+	.llseek  = seq_lseek,                                           \
+	.release = single_release,                                      \
+}
+
 static const struct trace_print_flags hif_msg_print_map[] = {
 	hif_msg_list,
 };
@@ -97,6 +127,28 @@ const char *wfx_get_reg_name(unsigned long id)
 	return get_symbol(id, wfx_reg_print_map);
 }
 
+void wfx_hist_show(struct seq_file *seq, const char *title, const struct wfx_hist *hist,
+		   const char *unit)
+{
+	u64 total = 0;
+	int i, last = 0;
+
+	for (i = 0; i < WFX_HIST_LEN; i++) {
+		total += hist->slot[i];
+		if (hist->slot[i])
+			last = i;
+	}
+	seq_printf(seq, "%s (%llu samples):\n", title, total);
+	if (!total)
+		return;
+	for (i = 0; i <= last; i++) {
+		if (i == WFX_HIST_LEN - 1)
+			seq_printf(seq, "  >= %8llu%s: %u\n", 1ULL << (i - 1), unit, hist->slot[i]);
+		else
+			seq_printf(seq, "   < %8llu%s: %u\n", 1ULL << i, unit, hist->slot[i]);
+	}
+}
+
 static int wfx_counters_show(struct seq_file *seq, void *v)
 {
 	int ret, i;
@@ -241,6 +293,276 @@ static int wfx_tx_power_loop_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(wfx_tx_power_loop);
 
+static int wfx_chip_wakeup_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif *hif = &wdev->hif;
+	static const char * const state_names[] = {
+		[WFX_CHIP_ASLEEP]   = "asleep",
+		[WFX_CHIP_AWAKE]    = "awake",
+		[WFX_CHIP_HOLD_OFF] = "hold-off",
+	};
+
+	if (!wdev->pdata.gpio_wakeup) {
+		seq_puts(seq, "wake-up gpio is not available, chip is always awake\n");
+		return 0;
+	}
+	mutex_lock(&hif->chip_state_lock);
+	seq_printf(seq, "State: %s\n", state_names[hif->chip_state]);
+	seq_printf(seq, "Load: %s\n", hif->load_busy ? "busy" : "idle");
+	seq_printf(seq, "Wake-ups: %lu\n", hif->num_wakeups);
+	seq_printf(seq, "Releases: %lu\n", hif->num_releases);
+	seq_printf(seq, "Wake-ups avoided by hold-off: %lu\n", hif->num_wakeups_saved);
+	wfx_hist_show(seq, "Wake-up latency", &hif->wakeup_latency, "us");
+	mutex_unlock(&hif->chip_state_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_chip_wakeup);
+
+static int wfx_fw_load_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_fw_stats *st = &wdev->fw_stats;
+
+	seq_printf(seq, "Mode: %s\n", st->pipelined ? "pipelined" : "legacy");
+	seq_printf(seq, "Size: %u bytes\n", st->load_bytes);
+	seq_printf(seq, "Duration: %lldus\n", st->load_us);
+	if (st->load_us)
+		seq_printf(seq, "Throughput: %lld bytes/s\n",
+			   div64_s64((s64)st->load_bytes * USEC_PER_SEC, st->load_us));
+	seq_printf(seq, "Bus writes: %u\n", st->num_writes);
+	seq_printf(seq, "Status polls: %u\n", st->num_polls);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_fw_load);
+
+static int wfx_bh_stats_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_bh_stats stats;
+
+	/* The 64-bit counters cannot be read atomically on 32-bit architectures */
+	wfx_bh_stats_get(wdev, &stats);
+
+	seq_printf(seq, "Passes: %llu\n", stats.num_passes);
+	seq_printf(seq, "Empty passes: %llu\n", stats.num_empty_passes);
+	seq_printf(seq, "Messages sent: %llu\n", stats.num_tx);
+	seq_printf(seq, "Messages received: %llu\n", stats.num_rx);
+	seq_printf(seq, "  after an IRQ: %llu\n", stats.num_rx_irq);
+	seq_printf(seq, "  chained by piggyback: %llu\n", stats.num_rx_piggyback);
+	seq_printf(seq, "Tx budget exhausted: %llu\n", stats.num_tx_budget_hits);
+	seq_printf(seq, "Rx budget exhausted: %llu\n", stats.num_rx_budget_hits);
+	if (stats.num_passes)
+		seq_printf(seq, "Time per pass: %lluns (max: %lluns)\n",
+			   div64_u64(stats.time_ns, stats.num_passes), stats.max_ns);
+	wfx_hist_show(seq, "Messages per pass", &stats.msgs_per_pass, "");
+	wfx_hist_show(seq, "Time per pass", &stats.time_per_pass, "us");
+
+	return 0;
+}
+
+/* Any write resets the statistics */
+static int wfx_bh_stats_trigger(struct wfx_dev *wdev)
+{
+	wfx_bh_stats_reset(wdev);
+	return 0;
+}
+DEFINE_SHOW_TRIGGER_ATTRIBUTE(wfx_bh_stats);
+
+static int wfx_bus_stats_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+
+	return wfx_io_stats_show(seq, wdev);
+}
+
+/* Any write resets the statistics */
+static int wfx_bus_stats_trigger(struct wfx_dev *wdev)
+{
+	wfx_io_stats_reset(wdev);
+	return 0;
+}
+DEFINE_SHOW_TRIGGER_ATTRIBUTE(wfx_bus_stats);
+
+static int wfx_tx_latency_show(struct seq_file *seq, void *v)
+{
+	static const char * const ac_names[] = {
+		[IEEE80211_AC_VO] = "VO",
+		[IEEE80211_AC_VI] = "VI",
+		[IEEE80211_AC_BE] = "BE",
+		[IEEE80211_AC_BK] = "BK",
+	};
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_tx_latency latency;
+	struct wfx_vif *wvif = NULL;
+	struct wfx_queue *queue;
+	int i;
+
+	mutex_lock(&wdev->conf_mutex);
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			queue = &wvif->tx_queue[i];
+			spin_lock(&queue->latency_lock);
+			latency = queue->latency;
+			spin_unlock(&queue->latency_lock);
+			seq_printf(seq, "vif %d, queue %s:\n", wvif->id, ac_names[i]);
+			wfx_hist_show(seq, "Host queue", &latency.host, "us");
+			wfx_hist_show(seq, "Firmware", &latency.fw, "us");
+			wfx_hist_show(seq, "Media delay", &latency.media, "us");
+			wfx_hist_show(seq, "End-to-end", &latency.total, "us");
+		}
+	}
+	mutex_unlock(&wdev->conf_mutex);
+
+	return 0;
+}
+
+/* Any write resets the histograms */
+static int wfx_tx_latency_trigger(struct wfx_dev *wdev)
+{
+	struct wfx_vif *wvif = NULL;
+	struct wfx_queue *queue;
+	int i;
+
+	mutex_lock(&wdev->conf_mutex);
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			queue = &wvif->tx_queue[i];
+			/* The bh updates the histograms on each Tx confirmation */
+			spin_lock(&queue->latency_lock);
+			memset(&queue->latency, 0, sizeof(queue->latency));
+			spin_unlock(&queue->latency_lock);
+		}
+	}
+	mutex_unlock(&wdev->conf_mutex);
+	return 0;
+}
+DEFINE_SHOW_TRIGGER_ATTRIBUTE(wfx_tx_latency);
+
+static int wfx_tim_stats_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_vif *wvif = NULL;
+
+	mutex_lock(&wdev->conf_mutex);
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		seq_printf(seq, "vif %d:\n", wvif->id);
+		seq_printf(seq, "  TIM updates sent: %lu\n", wvif->tim_num_sent);
+		seq_printf(seq, "  TIM updates skipped: %lu\n", wvif->tim_num_skipped);
+	}
+	mutex_unlock(&wdev->conf_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_tim_stats);
+
+static int wfx_ps_adaptive_show(struct seq_file *seq, void *v)
+{
+	static const char * const ac_names[] = {
+		[IEEE80211_AC_VO] = "VO",
+		[IEEE80211_AC_VI] = "VI",
+		[IEEE80211_AC_BE] = "BE",
+		[IEEE80211_AC_BK] = "BK",
+	};
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_vif *wvif = NULL;
+	s64 gap_us[IEEE80211_NUM_ACS];
+	bool fw_known, fw_ps;
+	int fw_ps_timeout;
+	unsigned int i, j;
+
+	mutex_lock(&wdev->conf_mutex);
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		spin_lock_bh(&wvif->pm_lock);
+		fw_known = wvif->pm_fw_known;
+		fw_ps = wvif->pm_fw_ps;
+		fw_ps_timeout = wvif->pm_fw_ps_timeout;
+		spin_unlock_bh(&wvif->pm_lock);
+		spin_lock_bh(&wvif->ps_adapt_lock);
+		memcpy(gap_us, wvif->ps_adapt_gap_us, sizeof(gap_us));
+		spin_unlock_bh(&wvif->ps_adapt_lock);
+
+		seq_printf(seq, "vif %d:\n", wvif->id);
+		if (fw_known)
+			seq_printf(seq, "  firmware timeout: %d ms%s\n", fw_ps_timeout,
+				   fw_ps ? "" : " (PS disabled)");
+		else
+			seq_puts(seq, "  firmware timeout: unknown\n");
+		seq_printf(seq, "  adaptive timeout: %d ms\n", wvif->ps_adapt_timeout);
+		for (i = 0; i < IEEE80211_NUM_ACS; i++)
+			seq_printf(seq, "  average gap %s: %lld us\n", ac_names[i], gap_us[i]);
+		seq_puts(seq, "  history:\n");
+		for (i = 0; i < min_t(unsigned int, wvif->ps_adapt_hist_cnt, WFX_PS_ADAPT_HIST_LEN);
+		     i++) {
+			j = (wvif->ps_adapt_hist_cnt - 1 - i) % WFX_PS_ADAPT_HIST_LEN;
+			seq_printf(seq, "    %3d ms, %u ms ago\n", wvif->ps_adapt_hist_val[j],
+				   jiffies_to_msecs(jiffies - wvif->ps_adapt_hist_time[j]));
+		}
+	}
+	mutex_unlock(&wdev->conf_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_ps_adaptive);
+
+static int wfx_firmware_cache_show(struct seq_file *seq, void *v)
+{
+	wfx_fw_cache_show(seq);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_firmware_cache);
+
+static int wfx_secure_link_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+
+	wfx_sl_show(seq, wdev);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_secure_link);
+
+static int wfx_secure_link_bench_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+
+	wfx_sl_bench_show(seq, wdev);
+	return 0;
+}
+
+/* Any write runs the benchmarks */
+static int wfx_secure_link_bench_trigger(struct wfx_dev *wdev)
+{
+	return wfx_sl_bench(wdev);
+}
+DEFINE_SHOW_TRIGGER_ATTRIBUTE(wfx_secure_link_bench);
+
+static int wfx_recovery_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+
+	seq_printf(seq, "State: %s\n", READ_ONCE(wdev->chip_frozen) ? "frozen" : "running");
+	seq_printf(seq, "Recoveries: %u\n", wdev->num_recoveries);
+	seq_printf(seq, "Failures: %u\n", wdev->num_recovery_failures);
+	seq_printf(seq, "Last duration: %lldus\n", wdev->last_recovery_us);
+	seq_printf(seq, "Max duration: %lldus\n", wdev->max_recovery_us);
+
+	return 0;
+}
+
+/* Any write simulates a frozen chip. Refuse it if the chip could not be recovered. */
+static int wfx_recovery_trigger(struct wfx_dev *wdev)
+{
+	if (!wfx_chip_can_recover(wdev))
+		return -EOPNOTSUPP;
+	if (READ_ONCE(wdev->recovery_blocked))
+		return -EBUSY;
+	wfx_chip_set_frozen(wdev);
+	return 0;
+}
+DEFINE_SHOW_TRIGGER_ATTRIBUTE(wfx_recovery);
+
 static ssize_t wfx_send_pds_write(struct file *file, const char __user *user_buf,
 				  size_t count, loff_t *ppos)
 {
@@ -447,6 +769,17 @@ int wfx_debug_init(struct wfx_dev *wdev)
 	debugfs_create_file("counters", 0444, d, wdev, &wfx_counters_fops);
 	debugfs_create_file("rx_stats", 0444, d, wdev, &wfx_rx_stats_fops);
 	debugfs_create_file("tx_power_loop", 0444, d, wdev, &wfx_tx_power_loop_fops);
+	debugfs_create_file("chip_wakeup", 0444, d, wdev, &wfx_chip_wakeup_fops);
+	debugfs_create_file("fw_load", 0444, d, wdev, &wfx_fw_load_fops);
+	debugfs_create_file("fw_cache", 0444, d, wdev, &wfx_firmware_cache_fops);
+	debugfs_create_file("bh_stats", 0600, d, wdev, &wfx_bh_stats_fops);
+	debugfs_create_file("bus_stats", 0600, d, wdev, &wfx_bus_stats_fops);
+	debugfs_create_file("tx_latency", 0600, d, wdev, &wfx_tx_latency_fops);
+	debugfs_create_file("tim_stats", 0444, d, wdev, &wfx_tim_stats_fops);
+	debugfs_create_file("ps_adaptive", 0444, d, wdev, &wfx_ps_adaptive_fops);
+	debugfs_create_file("recovery", 0600, d, wdev, &wfx_recovery_fops);
+	debugfs_create_file("secure_link", 0400, d, wdev, &wfx_secure_link_fops);
+	debugfs_create_file("secure_link_bench", 0600, d, wdev, &wfx_secure_link_bench_fops);
 	debugfs_create_file("send_pds", 0200, d, wdev, &wfx_send_pds_fops);
 	debugfs_create_file("burn_slk_key", 0200, d, wdev, &wfx_burn_slk_key_fops);
 	debugfs_create_file("send_hif_msg", 0600, d, wdev, &wfx_send_hif_msg_fops);
@@ -8,7 +8,28 @@
 #ifndef WFX_DEBUG_H
 #define WFX_DEBUG_H
 
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+
 struct wfx_dev;
+struct seq_file;
+
+#define WFX_HIST_LEN 20
+
+/* Log2 histogram. Slot 0 counts null values, slot n counts values in [2^(n-1), 2^n). The last
+ * slot also counts all the values above.
+ */
+struct wfx_hist {
+	u32 slot[WFX_HIST_LEN];
+};
+
+static inline void wfx_hist_add(struct wfx_hist *hist, u64 val)
+{
+	hist->slot[min_t(int, fls64(val), WFX_HIST_LEN - 1)]++;
+}
+
+void wfx_hist_show(struct seq_file *seq, const char *title, const struct wfx_hist *hist,
+		   const char *unit);
 
 int wfx_debug_init(struct wfx_dev *wdev);
 
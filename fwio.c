@@ -9,6 +9,9 @@
 #include <linux/firmware.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/seq_file.h>
+#include <linux/kref.h>
 
 #include "fwio.h"
 #include "wfx.h"
@@ -67,6 +70,181 @@
 #define DCA_TIMEOUT  50 /* milliseconds */
 #define WAKEUP_TIMEOUT 200 /* milliseconds */
 
+/* Number of blocks sent in one bus transfer in pipelined mode. Indirect accesses are limited to
+ * 8kB (minus one word).
+ */
+#define DNLD_BATCH_BLOCKS 7
+/* Upper bound of a sleep while waiting for the chip to consume the FIFO */
+#define DNLD_MAX_SLEEP 1000 /* microseconds */
+
+static bool fw_dnld_pipeline = true;
+module_param(fw_dnld_pipeline, bool, 0644);
+MODULE_PARM_DESC(fw_dnld_pipeline, "batch firmware blocks and estimate the chip progress during firmware download (default: true).");
+
+/* Firmware images and PDS are shared by all the devices (and kept across the resets of the chips).
+ * Each entry is identified by the name of the file and a key (the keyset for the firmware,
+ * WFX_FW_CACHE_PDS for the PDS). The list owns a reference on each entry.
+ */
+static LIST_HEAD(wfx_fw_cache);
+static DEFINE_MUTEX(wfx_fw_cache_lock);
+static struct {
+	u32 hits;
+	u32 misses;
+	s64 saved_us;
+} wfx_fw_cache_stats;
+
+static void wfx_fw_cache_release(struct kref *kref)
+{
+	struct wfx_fw_cache_entry *entry = container_of(kref, struct wfx_fw_cache_entry, refcount);
+
+	kfree(entry->data);
+	kfree(entry->name);
+	kfree(entry);
+}
+
+void wfx_fw_cache_put(struct wfx_fw_cache_entry *entry)
+{
+	if (entry)
+		kref_put(&entry->refcount, wfx_fw_cache_release);
+}
+
+/* Entries in use are freed once their users release them */
+void wfx_fw_cache_flush(void)
+{
+	struct wfx_fw_cache_entry *entry, *tmp;
+
+	mutex_lock(&wfx_fw_cache_lock);
+	list_for_each_entry_safe(entry, tmp, &wfx_fw_cache, link) {
+		list_del_init(&entry->link);
+		wfx_fw_cache_put(entry);
+	}
+	mutex_unlock(&wfx_fw_cache_lock);
+}
+
+static bool fw_cache = true;
+static int fw_cache_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (!ret)
+		wfx_fw_cache_flush();
+	return ret;
+}
+
+static const struct kernel_param_ops fw_cache_ops = {
+	.set = fw_cache_set,
+	.get = param_get_bool,
+};
+module_param_cb(fw_cache, &fw_cache_ops, &fw_cache, 0644);
+MODULE_PARM_DESC(fw_cache, "keep firmware and PDS in memory for the next chip initializations. Any write to this parameter flushes the cache (default: true).");
+
+static struct wfx_fw_cache_entry *wfx_fw_cache_find(const char *name, int key)
+{
+	struct wfx_fw_cache_entry *entry;
+
+	lockdep_assert_held(&wfx_fw_cache_lock);
+	list_for_each_entry(entry, &wfx_fw_cache, link)
+		if (entry->key == key && !strcmp(entry->name, name))
+			return entry;
+	return NULL;
+}
+
+struct wfx_fw_cache_entry *wfx_fw_cache_get(const char *name, int key)
+{
+	struct wfx_fw_cache_entry *entry;
+
+	if (!fw_cache)
+		return NULL;
+	mutex_lock(&wfx_fw_cache_lock);
+	entry = wfx_fw_cache_find(name, key);
+	if (entry) {
+		kref_get(&entry->refcount);
+		entry->hits++;
+		wfx_fw_cache_stats.hits++;
+		wfx_fw_cache_stats.saved_us += entry->load_us;
+	} else {
+		wfx_fw_cache_stats.misses++;
+	}
+	mutex_unlock(&wfx_fw_cache_lock);
+	return entry;
+}
+
+/* data is copied in a buffer compatible with DMA. load_us is the time spent to build data. It is
+ * accounted as saved on every cache hit. Return NULL if the cache is disabled or on allocation
+ * failure. In this case, the caller should continue with its own copy of data.
+ */
+struct wfx_fw_cache_entry *wfx_fw_cache_add(const char *name, int key, const u8 *data,
+					    size_t len, int offset, s64 load_us)
+{
+	struct wfx_fw_cache_entry *entry, *prev;
+
+	if (!fw_cache)
+		return NULL;
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return NULL;
+	entry->name = kstrdup(name, GFP_KERNEL);
+	entry->data = kmemdup(data, len, GFP_KERNEL | __GFP_NOWARN);
+	if (!entry->name || !entry->data) {
+		kfree(entry->data);
+		kfree(entry->name);
+		kfree(entry);
+		return NULL;
+	}
+	kref_init(&entry->refcount);
+	entry->key = key;
+	entry->len = len;
+	entry->offset = offset;
+	entry->load_us = load_us;
+
+	mutex_lock(&wfx_fw_cache_lock);
+	/* Another device may have loaded the same file in the meantime */
+	prev = wfx_fw_cache_find(name, key);
+	if (prev)
+		list_del_init(&prev->link);
+	list_add(&entry->link, &wfx_fw_cache);
+	/* One reference for the list, one for the caller */
+	kref_get(&entry->refcount);
+	mutex_unlock(&wfx_fw_cache_lock);
+	wfx_fw_cache_put(prev);
+	return entry;
+}
+
+/* Remove an entry that does not work (ie. the file has been updated since it was loaded) */
+void wfx_fw_cache_invalidate(struct wfx_fw_cache_entry *entry)
+{
+	bool listed = false;
+
+	mutex_lock(&wfx_fw_cache_lock);
+	if (!list_empty(&entry->link)) {
+		list_del_init(&entry->link);
+		listed = true;
+	}
+	mutex_unlock(&wfx_fw_cache_lock);
+	if (listed)
+		wfx_fw_cache_put(entry);
+}
+
+void wfx_fw_cache_show(struct seq_file *seq)
+{
+	struct wfx_fw_cache_entry *entry;
+
+	mutex_lock(&wfx_fw_cache_lock);
+	seq_printf(seq, "Enabled: %s\n", fw_cache ? "yes" : "no");
+	seq_printf(seq, "Hits: %u\n", wfx_fw_cache_stats.hits);
+	seq_printf(seq, "Misses: %u\n", wfx_fw_cache_stats.misses);
+	seq_printf(seq, "Load time saved: %lldus\n", wfx_fw_cache_stats.saved_us);
+	list_for_each_entry(entry, &wfx_fw_cache, link) {
+		if (entry->key == WFX_FW_CACHE_PDS)
+			seq_printf(seq, "  %s (PDS): ", entry->name);
+		else
+			seq_printf(seq, "  %s (keyset %02X): ", entry->name, entry->key);
+		seq_printf(seq, "%zu bytes, loaded in %lldus, %u hits\n",
+			   entry->len, entry->load_us, entry->hits);
+	}
+	mutex_unlock(&wfx_fw_cache_lock);
+}
+
 static const char * const fwio_errors[] = {
 	[ERR_INVALID_SEC_TYPE] = "Invalid section type or wrong encryption",
 	[ERR_SIG_VERIF_FAILED] = "Signature verification failed",
@@ -81,7 +259,8 @@ static const char * const fwio_errors[] = {
  * Notice that, in doubt, you can enable CONFIG_DEBUG_SG to ask kernel to detect this problem at
  * runtime  (else, kernel silently fail).
  *
- * NOTE: it may also be possible to use 'pages' from struct firmware and avoid bounce buffer
+ * In most cases, the whole image has already been copied by the firmware cache or by
+ * wfx_fw_dma_safe_copy(). So, this function only allocates memory if these copies failed.
  */
 static int wfx_sram_write_dma_safe(struct wfx_dev *wdev, u32 addr, const u8 *buf, size_t len)
 {
@@ -101,6 +280,24 @@ static int wfx_sram_write_dma_safe(struct wfx_dev *wdev, u32 addr, const u8 *buf
 	return ret;
 }
 
+/* Copy the firmware in a buffer compatible with DMA. This is only necessary when the firmware cache
+ * is disabled (the cache already keeps such a copy). The buffer is freed once the firmware is
+ * loaded. Return NULL if no copy is needed or if the allocation fails. In the last case,
+ * wfx_sram_write_dma_safe() falls back to a bounce buffer for each block.
+ */
+static u8 *wfx_fw_dma_safe_copy(struct wfx_dev *wdev, const struct firmware *fw)
+{
+	u8 *copy;
+
+	if (virt_addr_valid(fw->data))
+		return NULL;
+	copy = kmemdup(fw->data, fw->size, GFP_KERNEL | __GFP_NOWARN);
+	if (!copy)
+		dev_dbg(wdev->dev, "cannot allocate %zu bytes, use a bounce buffer per block\n",
+			fw->size);
+	return copy;
+}
+
 static int get_firmware(struct wfx_dev *wdev, u32 keyset_chip,
 			const struct firmware **fw, int *file_offset)
 {
@@ -200,6 +397,7 @@ static int upload_firmware(struct wfx_dev *wdev, const u8 *data, size_t len)
 			ret = wfx_sram_reg_read(wdev, WFX_DCA_GET, &bytes_done);
 			if (ret < 0)
 				return ret;
+			wdev->fw_stats.num_polls++;
 		}
 		if (ktime_compare(now, start))
 			dev_dbg(wdev->dev, "answer after %lldus\n", ktime_us_delta(now, start));
@@ -208,6 +406,7 @@ static int upload_firmware(struct wfx_dev *wdev, const u8 *data, size_t len)
 					      data + offs, DNLD_BLOCK_SIZE);
 		if (ret < 0)
 			return ret;
+		wdev->fw_stats.num_writes++;
 
 		/* The device seems to not support writing 0 in this register during first loop */
 		offs += DNLD_BLOCK_SIZE;
@@ -218,6 +417,76 @@ static int upload_firmware(struct wfx_dev *wdev, const u8 *data, size_t len)
 	return 0;
 }
 
+/* Reading WFX_DCA_GET costs several bus accesses. Rather than polling it continuously, estimate
+ * the speed of the chip from the previous reads and sleep until there is enough room in the FIFO
+ * for a full batch of blocks. The FIFO is only filled according to the last value actually read,
+ * so a wrong estimation only costs an extra poll.
+ */
+static int upload_firmware_pipelined(struct wfx_dev *wdev, const u8 *data, size_t len)
+{
+	u32 put = 0, get = 0, last_get = 0;
+	ktime_t now, start, last_get_date;
+	s64 rate_us = 0, rate_bytes = 0;
+	s64 wait_us;
+	size_t batch, room;
+	int ret;
+
+	if (len % DNLD_BLOCK_SIZE) {
+		dev_err(wdev->dev, "firmware size is not aligned. Buffer overrun will occur\n");
+		return -EIO;
+	}
+	start = ktime_get();
+	last_get_date = start;
+	while (put < len) {
+		batch = min_t(size_t, DNLD_BATCH_BLOCKS * DNLD_BLOCK_SIZE, len - put);
+		/* Do not cross the end of the FIFO */
+		batch = min_t(size_t, batch, DNLD_FIFO_SIZE - put % DNLD_FIFO_SIZE);
+		room = round_down(DNLD_FIFO_SIZE - 1 - (put - get), DNLD_BLOCK_SIZE);
+		if (room) {
+			batch = min(batch, room);
+			ret = wfx_sram_write_dma_safe(wdev, WFX_DNLD_FIFO + (put % DNLD_FIFO_SIZE),
+						      data + put, batch);
+			if (ret < 0)
+				return ret;
+			/* The device seems to not support writing 0 in this register during first
+			 * loop
+			 */
+			put += batch;
+			ret = wfx_sram_reg_write(wdev, WFX_DCA_PUT, put);
+			if (ret < 0)
+				return ret;
+			wdev->fw_stats.num_writes++;
+			start = ktime_get();
+			continue;
+		}
+
+		now = ktime_get();
+		if (ktime_after(now, ktime_add_ms(start, DCA_TIMEOUT)))
+			return -ETIMEDOUT;
+		if (rate_bytes) {
+			/* Time necessary to consume the data that prevent to send a full batch */
+			wait_us = put - get + batch - (DNLD_FIFO_SIZE - 1);
+			wait_us = div64_s64(wait_us * rate_us, rate_bytes);
+			wait_us -= ktime_us_delta(now, last_get_date);
+			wait_us = min_t(s64, wait_us, DNLD_MAX_SLEEP);
+			if (wait_us > 10)
+				usleep_range(wait_us, wait_us + wait_us / 4);
+		}
+		ret = wfx_sram_reg_read(wdev, WFX_DCA_GET, &get);
+		if (ret < 0)
+			return ret;
+		wdev->fw_stats.num_polls++;
+		now = ktime_get();
+		if (get > last_get) {
+			rate_bytes = get - last_get;
+			rate_us = max_t(s64, ktime_us_delta(now, last_get_date), 1);
+			last_get = get;
+			last_get_date = now;
+		}
+	}
+	return 0;
+}
+
 static void print_boot_status(struct wfx_dev *wdev)
 {
 	u32 reg;
@@ -234,9 +503,14 @@ static void print_boot_status(struct wfx_dev *wdev)
 
 static int load_firmware_secure(struct wfx_dev *wdev)
 {
+	struct wfx_fw_cache_entry *cached = NULL;
 	const struct firmware *fw = NULL;
+	u8 *fw_copy = NULL;
+	const u8 *fw_data;
+	size_t fw_size;
 	int header_size;
 	int fw_offset;
+	int keyset;
 	ktime_t start;
 	u8 *buf;
 	int ret;
@@ -256,9 +530,28 @@ static int load_firmware_secure(struct wfx_dev *wdev)
 	dev_dbg(wdev->dev, "bootloader: \"%s\"\n", buf);
 
 	wfx_sram_buf_read(wdev, WFX_PTE_INFO, buf, PTE_INFO_SIZE);
-	ret = get_firmware(wdev, buf[PTE_INFO_KEYSET_IDX], &fw, &fw_offset);
-	if (ret)
-		goto error;
+	keyset = buf[PTE_INFO_KEYSET_IDX];
+	cached = wfx_fw_cache_get(wdev->pdata.file_fw, keyset);
+	if (cached) {
+		dev_dbg(wdev->dev, "use cached firmware for keyset %02X\n", keyset);
+		wdev->keyset = keyset;
+		fw_offset = cached->offset;
+	} else {
+		start = ktime_get();
+		ret = get_firmware(wdev, keyset, &fw, &fw_offset);
+		if (ret)
+			goto error;
+		cached = wfx_fw_cache_add(wdev->pdata.file_fw, keyset, fw->data, fw->size,
+					  fw_offset, ktime_us_delta(ktime_get(), start));
+	}
+	if (cached) {
+		fw_data = cached->data;
+		fw_size = cached->len;
+	} else {
+		fw_copy = wfx_fw_dma_safe_copy(wdev, fw);
+		fw_data = fw_copy ? fw_copy : fw->data;
+		fw_size = fw->size;
+	}
 	header_size = fw_offset + FW_SIGNATURE_SIZE + FW_HASH_SIZE;
 
 	wfx_sram_reg_write(wdev, WFX_DCA_HOST_STATUS, HOST_INFO_READ);
@@ -268,34 +561,50 @@ static int load_firmware_secure(struct wfx_dev *wdev)
 
 	wfx_sram_reg_write(wdev, WFX_DNLD_FIFO, 0xFFFFFFFF); /* Fifo init */
 	wfx_sram_write_dma_safe(wdev, WFX_DCA_FW_VERSION, "\x01\x00\x00\x00", FW_VERSION_SIZE);
-	wfx_sram_write_dma_safe(wdev, WFX_DCA_FW_SIGNATURE, fw->data + fw_offset,
+	wfx_sram_write_dma_safe(wdev, WFX_DCA_FW_SIGNATURE, fw_data + fw_offset,
 				FW_SIGNATURE_SIZE);
-	wfx_sram_write_dma_safe(wdev, WFX_DCA_FW_HASH, fw->data + fw_offset + FW_SIGNATURE_SIZE,
+	wfx_sram_write_dma_safe(wdev, WFX_DCA_FW_HASH, fw_data + fw_offset + FW_SIGNATURE_SIZE,
 				FW_HASH_SIZE);
-	wfx_sram_reg_write(wdev, WFX_DCA_IMAGE_SIZE, fw->size - header_size);
+	wfx_sram_reg_write(wdev, WFX_DCA_IMAGE_SIZE, fw_size - header_size);
 	wfx_sram_reg_write(wdev, WFX_DCA_HOST_STATUS, HOST_UPLOAD_PENDING);
 	ret = wait_ncp_status(wdev, NCP_DOWNLOAD_PENDING);
 	if (ret)
 		goto error;
 
+	memset(&wdev->fw_stats, 0, sizeof(wdev->fw_stats));
+	wdev->fw_stats.pipelined = fw_dnld_pipeline;
 	start = ktime_get();
-	ret = upload_firmware(wdev, fw->data + header_size, fw->size - header_size);
+	if (fw_dnld_pipeline)
+		ret = upload_firmware_pipelined(wdev, fw_data + header_size,
+						fw_size - header_size);
+	else
+		ret = upload_firmware(wdev, fw_data + header_size, fw_size - header_size);
 	if (ret)
 		goto error;
-	dev_dbg(wdev->dev, "firmware load after %lldus\n",
-		ktime_us_delta(ktime_get(), start));
+	wdev->fw_stats.load_us = max_t(s64, ktime_us_delta(ktime_get(), start), 1);
+	wdev->fw_stats.load_bytes = fw_size - header_size;
+	dev_info(wdev->dev, "firmware loaded in %lldus (%lld bytes/s, %u status polls)\n",
+		 wdev->fw_stats.load_us,
+		 div64_s64((s64)wdev->fw_stats.load_bytes * USEC_PER_SEC, wdev->fw_stats.load_us),
+		 wdev->fw_stats.num_polls);
 
 	wfx_sram_reg_write(wdev, WFX_DCA_HOST_STATUS, HOST_UPLOAD_COMPLETE);
 	ret = wait_ncp_status(wdev, NCP_AUTH_OK);
 	/* Legacy ROM support */
 	if (ret < 0)
 		ret = wait_ncp_status(wdev, NCP_PUB_KEY_RDY);
-	if (ret < 0)
+	if (ret < 0) {
+		/* The file may have been updated since it was cached. Read it again next time. */
+		if (cached)
+			wfx_fw_cache_invalidate(cached);
 		goto error;
+	}
 	wfx_sram_reg_write(wdev, WFX_DCA_HOST_STATUS, HOST_OK_TO_JUMP);
 
 error:
 	kfree(buf);
+	kfree(fw_copy);
+	wfx_fw_cache_put(cached);
 	release_firmware(fw);
 	if (ret)
 		print_boot_status(wdev);
@@ -8,8 +8,44 @@
 #ifndef WFX_FWIO_H
 #define WFX_FWIO_H
 
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/kref.h>
+
 struct wfx_dev;
+struct seq_file;
+
+#define WFX_FW_CACHE_PDS -1
+
+struct wfx_fw_cache_entry {
+	struct list_head link;
+	struct kref refcount;
+	char *name;
+	int key;
+	/* data is suitable for DMA */
+	u8 *data;
+	size_t len;
+	int offset;
+	s64 load_us;
+	u32 hits;
+};
+
+struct wfx_fw_stats {
+	s64 load_us;
+	u32 load_bytes;
+	u32 num_polls;
+	u32 num_writes;
+	bool pipelined;
+};
 
 int wfx_init_device(struct wfx_dev *wdev);
 
+struct wfx_fw_cache_entry *wfx_fw_cache_get(const char *name, int key);
+struct wfx_fw_cache_entry *wfx_fw_cache_add(const char *name, int key, const u8 *data,
+					    size_t len, int offset, s64 load_us);
+void wfx_fw_cache_put(struct wfx_fw_cache_entry *entry);
+void wfx_fw_cache_invalidate(struct wfx_fw_cache_entry *entry);
+void wfx_fw_cache_flush(void);
+void wfx_fw_cache_show(struct seq_file *seq);
+
 #endif
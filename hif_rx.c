@@ -181,7 +181,7 @@ static int wfx_hif_pm_mode_complete_indication(struct wfx_dev *wdev,
 		dev_warn(wdev->dev, "%s: received event for non-existent vif\n", __func__);
 		return -EIO;
 	}
-	complete(&wvif->set_pm_mode_complete);
+	wfx_set_pm_mode_complete(wvif);
 
 	return 0;
 }
@@ -342,7 +342,7 @@ static int wfx_hif_error_indication(struct wfx_dev *wdev,
 		dev_err(wdev->dev, "asynchronous error: unknown: %08x\n", type);
 	print_hex_dump(KERN_INFO, "hif: ", DUMP_PREFIX_OFFSET,
 		       16, 1, hif, le16_to_cpu(hif->len), false);
-	wdev->chip_frozen = true;
+	wfx_chip_set_frozen(wdev);
 
 	return 0;
 };
@@ -359,7 +359,7 @@ static int wfx_hif_exception_indication(struct wfx_dev *wdev,
 		dev_err(wdev->dev, "firmware exception\n");
 	print_hex_dump(KERN_INFO, "hif: ", DUMP_PREFIX_OFFSET,
 		       16, 1, hif, le16_to_cpu(hif->len), false);
-	wdev->chip_frozen = true;
+	wfx_chip_set_frozen(wdev);
 
 	return -1;
 }
@@ -74,7 +74,7 @@ int wfx_cmd_send(struct wfx_dev *wdev, struct wfx_hif_msg *request,
 	int ret;
 
 	/* Do not wait for any reply if chip is frozen */
-	if (wdev->chip_frozen)
+	if (READ_ONCE(wdev->chip_frozen))
 		return -ETIMEDOUT;
 
 	if (cmd != HIF_REQ_ID_SL_EXCHANGE_PUB_KEYS)
@@ -112,7 +112,7 @@ int wfx_cmd_send(struct wfx_dev *wdev, struct wfx_hif_msg *request,
 	if (!ret) {
 		dev_err(wdev->dev, "chip did not answer\n");
 		wfx_pending_dump_old_frames(wdev, 3000);
-		wdev->chip_frozen = true;
+		wfx_chip_set_frozen(wdev);
 		reinit_completion(&wdev->hif_cmd.done);
 		ret = -ETIMEDOUT;
 	} else {
@@ -153,10 +153,7 @@ int wfx_hif_shutdown(struct wfx_dev *wdev)
 		return -ENOMEM;
 	wfx_fill_header(hif, -1, HIF_REQ_ID_SHUT_DOWN, 0);
 	ret = wfx_cmd_send(wdev, hif, NULL, 0, true);
-	if (wdev->pdata.gpio_wakeup)
-		gpiod_set_value(wdev->pdata.gpio_wakeup, 0);
-	else
-		wfx_control_reg_write(wdev, 0);
+	wfx_bh_shutdown(wdev);
 	kfree(hif);
 	return ret;
 }
@@ -269,8 +266,9 @@ int wfx_hif_scan_uniq(struct wfx_vif *wvif, struct ieee80211_channel *chan, int
 	return ret;
 }
 
+/* If max_dwell_ms is not 0, it reduces the time spent on the channels during an active scan */
 int wfx_hif_scan(struct wfx_vif *wvif, struct cfg80211_scan_request *req,
-		 int chan_start_idx, int chan_num)
+		 int chan_start_idx, int chan_num, unsigned int max_dwell_ms)
 {
 	int ret, i;
 	struct wfx_hif_msg *hif;
@@ -299,10 +297,14 @@ int wfx_hif_scan(struct wfx_vif *wvif, struct cfg80211_scan_request *req,
 		body->max_transmit_rate = API_RATE_INDEX_B_1MBPS;
 	if (req->channels[chan_start_idx]->flags & IEEE80211_CHAN_NO_IR) {
 		body->min_channel_time = cpu_to_le32(50);
-		body->max_channel_time = cpu_to_le32(150);
+		body->max_channel_time = cpu_to_le32(WFX_SCAN_PASSIVE_DWELL_MS);
 	} else {
-		body->min_channel_time = cpu_to_le32(10);
-		body->max_channel_time = cpu_to_le32(50);
+		if (!max_dwell_ms)
+			max_dwell_ms = WFX_SCAN_ACTIVE_DWELL_MS;
+		max_dwell_ms = clamp_t(unsigned int, max_dwell_ms, WFX_SCAN_ACTIVE_MIN_DWELL_MS,
+				       WFX_SCAN_ACTIVE_DWELL_MS);
+		body->min_channel_time = cpu_to_le32(WFX_SCAN_ACTIVE_MIN_DWELL_MS);
+		body->max_channel_time = cpu_to_le32(max_dwell_ms);
 		body->num_of_probe_requests = 2;
 		body->probe_delay = 100;
 	}
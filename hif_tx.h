@@ -23,6 +23,11 @@ struct wfx_hif_req_pta_settings;
 struct wfx_dev;
 struct wfx_vif;
 
+/* Time spent on each channel during a scan */
+#define WFX_SCAN_ACTIVE_MIN_DWELL_MS 10
+#define WFX_SCAN_ACTIVE_DWELL_MS     50
+#define WFX_SCAN_PASSIVE_DWELL_MS    150
+
 struct wfx_hif_cmd {
 	struct mutex       lock;
 	struct mutex       key_renew_lock;
@@ -55,7 +60,7 @@ int wfx_hif_set_edca_queue_params(struct wfx_vif *wvif, u16 queue,
 int wfx_hif_beacon_transmit(struct wfx_vif *wvif, bool enable);
 int wfx_hif_update_ie_beacon(struct wfx_vif *wvif, const u8 *ies, size_t ies_len);
 int wfx_hif_scan(struct wfx_vif *wvif, struct cfg80211_scan_request *req80211,
-		 int chan_start, int chan_num);
+		 int chan_start, int chan_num, unsigned int max_dwell_ms);
 int wfx_hif_scan_uniq(struct wfx_vif *wvif, struct ieee80211_channel *chan, int duration);
 int wfx_hif_stop_scan(struct wfx_vif *wvif);
 int wfx_hif_configuration(struct wfx_dev *wdev, const u8 *conf, size_t len);
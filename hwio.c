@@ -9,6 +9,7 @@
 #include <linux/kernel.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/seq_file.h>
 
 #include "hwio.h"
 #include "wfx.h"
@@ -21,6 +22,55 @@
 
 #define WFX_HIF_BUFFER_SIZE 0x2000
 
+static enum wfx_io_class wfx_io_get_class(int reg, bool write)
+{
+	switch (reg) {
+	case WFX_REG_IN_OUT_QUEUE:
+		return write ? WFX_IO_DATA_WRITE : WFX_IO_DATA_READ;
+	case WFX_REG_AHB_DPORT:
+	case WFX_REG_SRAM_DPORT:
+		return write ? WFX_IO_IND_WRITE : WFX_IO_IND_READ;
+	default:
+		return write ? WFX_IO_REG_WRITE : WFX_IO_REG_READ;
+	}
+}
+
+static void wfx_io_account(struct wfx_dev *wdev, int reg, bool write, size_t len, ktime_t start)
+{
+	struct wfx_io_class_stats *st = &wdev->io_stats.class[wfx_io_get_class(reg, write)];
+	u64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&wdev->io_stats.lock);
+	st->count++;
+	st->bytes += len;
+	st->time_ns += delta;
+	st->max_ns = max(st->max_ns, delta);
+	wfx_hist_add(&st->latency, div_u64(delta, NSEC_PER_USEC));
+	spin_unlock(&wdev->io_stats.lock);
+}
+
+/* The bus lock must be held */
+static int wfx_copy_from_io(struct wfx_dev *wdev, int reg, void *buf, size_t len)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = wdev->hwbus_ops->copy_from_io(wdev->hwbus_priv, reg, buf, len);
+	wfx_io_account(wdev, reg, false, len, start);
+	return ret;
+}
+
+/* The bus lock must be held */
+static int wfx_copy_to_io(struct wfx_dev *wdev, int reg, const void *buf, size_t len)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = wdev->hwbus_ops->copy_to_io(wdev->hwbus_priv, reg, buf, len);
+	wfx_io_account(wdev, reg, true, len, start);
+	return ret;
+}
+
 static int wfx_read32(struct wfx_dev *wdev, int reg, u32 *val)
 {
 	int ret;
@@ -29,7 +79,7 @@ static int wfx_read32(struct wfx_dev *wdev, int reg, u32 *val)
 	*val = ~0; /* Never return undefined value */
 	if (!tmp)
 		return -ENOMEM;
-	ret = wdev->hwbus_ops->copy_from_io(wdev->hwbus_priv, reg, tmp, sizeof(u32));
+	ret = wfx_copy_from_io(wdev, reg, tmp, sizeof(u32));
 	if (ret >= 0)
 		*val = le32_to_cpu(*tmp);
 	kfree(tmp);
@@ -46,7 +96,7 @@ static int wfx_write32(struct wfx_dev *wdev, int reg, u32 val)
 	if (!tmp)
 		return -ENOMEM;
 	*tmp = cpu_to_le32(val);
-	ret = wdev->hwbus_ops->copy_to_io(wdev->hwbus_priv, reg, tmp, sizeof(u32));
+	ret = wfx_copy_to_io(wdev, reg, tmp, sizeof(u32));
 	kfree(tmp);
 	if (ret)
 		dev_err(wdev->dev, "%s: bus communication error: %d\n", __func__, ret);
@@ -139,7 +189,7 @@ static int wfx_indirect_read(struct wfx_dev *wdev, int reg, u32 addr, void *buf,
 		goto err;
 	}
 
-	ret = wdev->hwbus_ops->copy_from_io(wdev->hwbus_priv, reg, buf, len);
+	ret = wfx_copy_from_io(wdev, reg, buf, len);
 
 err:
 	if (ret < 0)
@@ -158,7 +208,7 @@ static int wfx_indirect_write(struct wfx_dev *wdev, int reg, u32 addr,
 	if (ret < 0)
 		return ret;
 
-	return wdev->hwbus_ops->copy_to_io(wdev->hwbus_priv, reg, buf, len);
+	return wfx_copy_to_io(wdev, reg, buf, len);
 }
 
 static int wfx_indirect_read_locked(struct wfx_dev *wdev, int reg, u32 addr,
@@ -223,7 +273,7 @@ int wfx_data_read(struct wfx_dev *wdev, void *buf, size_t len)
 
 	WARN(!IS_ALIGNED((uintptr_t)buf, 4), "unaligned buffer");
 	wdev->hwbus_ops->lock(wdev->hwbus_priv);
-	ret = wdev->hwbus_ops->copy_from_io(wdev->hwbus_priv, WFX_REG_IN_OUT_QUEUE, buf, len);
+	ret = wfx_copy_from_io(wdev, WFX_REG_IN_OUT_QUEUE, buf, len);
 	_trace_io_read(WFX_REG_IN_OUT_QUEUE, buf, len);
 	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
 	if (ret)
@@ -237,7 +287,7 @@ int wfx_data_write(struct wfx_dev *wdev, const void *buf, size_t len)
 
 	WARN(!IS_ALIGNED((uintptr_t)buf, 4), "unaligned buffer");
 	wdev->hwbus_ops->lock(wdev->hwbus_priv);
-	ret = wdev->hwbus_ops->copy_to_io(wdev->hwbus_priv, WFX_REG_IN_OUT_QUEUE, buf, len);
+	ret = wfx_copy_to_io(wdev, WFX_REG_IN_OUT_QUEUE, buf, len);
 	_trace_io_write(WFX_REG_IN_OUT_QUEUE, buf, len);
 	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
 	if (ret)
@@ -334,3 +384,61 @@ int wfx_igpr_reg_write(struct wfx_dev *wdev, int index, u32 val)
 {
 	return wfx_write32_locked(wdev, WFX_REG_SET_GEN_R_W, index << 24 | val);
 }
+
+void wfx_io_stats_reset(struct wfx_dev *wdev)
+{
+	spin_lock(&wdev->io_stats.lock);
+	memset(wdev->io_stats.class, 0, sizeof(wdev->io_stats.class));
+	wdev->io_stats.start = ktime_get();
+	spin_unlock(&wdev->io_stats.lock);
+}
+
+int wfx_io_stats_show(struct seq_file *seq, struct wfx_dev *wdev)
+{
+	static const char * const class_names[] = {
+		[WFX_IO_DATA_READ]  = "Data read",
+		[WFX_IO_DATA_WRITE] = "Data write",
+		[WFX_IO_REG_READ]   = "Register read",
+		[WFX_IO_REG_WRITE]  = "Register write",
+		[WFX_IO_IND_READ]   = "Indirect read",
+		[WFX_IO_IND_WRITE]  = "Indirect write",
+	};
+	struct wfx_io_class_stats *stats, *st;
+	u64 busy_ns = 0, bytes = 0;
+	u64 elapsed_us, busy_us;
+	int i;
+
+	/* Too large for the stack. The copy keeps the bus from waiting for the formatting. */
+	stats = kmalloc(sizeof(wdev->io_stats.class), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+	spin_lock(&wdev->io_stats.lock);
+	memcpy(stats, wdev->io_stats.class, sizeof(wdev->io_stats.class));
+	elapsed_us = max_t(s64, ktime_us_delta(ktime_get(), wdev->io_stats.start), 1);
+	spin_unlock(&wdev->io_stats.lock);
+
+	for (i = 0; i < WFX_IO_NUM_CLASSES; i++) {
+		st = &stats[i];
+		busy_ns += st->time_ns;
+		bytes += st->bytes;
+		seq_printf(seq, "%s: %llu transfers, %llu bytes\n", class_names[i], st->count,
+			   st->bytes);
+		if (!st->count)
+			continue;
+		seq_printf(seq, "  Average: %lluns, max: %lluns\n", div64_u64(st->time_ns, st->count),
+			   st->max_ns);
+		/* Speed of the bus during the transfers vs average throughput */
+		busy_us = max_t(u64, div_u64(st->time_ns, NSEC_PER_USEC), 1);
+		seq_printf(seq, "  Transfer rate: %llu bytes/s\n",
+			   div64_u64(st->bytes * USEC_PER_SEC, busy_us));
+		seq_printf(seq, "  Throughput: %llu bytes/s\n",
+			   div64_u64(st->bytes * USEC_PER_SEC, elapsed_us));
+		wfx_hist_show(seq, "  Latency", &st->latency, "us");
+	}
+	busy_us = div_u64(busy_ns, NSEC_PER_USEC);
+	seq_printf(seq, "Period: %lluus\n", elapsed_us);
+	seq_printf(seq, "Bus busy: %lluus (%llu%%)\n", busy_us, div64_u64(busy_us * 100, elapsed_us));
+	seq_printf(seq, "Throughput: %llu bytes/s\n", div64_u64(bytes * USEC_PER_SEC, elapsed_us));
+	kfree(stats);
+	return 0;
+}
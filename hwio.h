@@ -9,8 +9,42 @@
 #define WFX_HWIO_H
 
 #include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+
+#include "debug.h"
 
 struct wfx_dev;
+struct seq_file;
+
+enum wfx_io_class {
+	WFX_IO_DATA_READ,
+	WFX_IO_DATA_WRITE,
+	WFX_IO_REG_READ,
+	WFX_IO_REG_WRITE,
+	WFX_IO_IND_READ,
+	WFX_IO_IND_WRITE,
+	WFX_IO_NUM_CLASSES,
+};
+
+/* Time spent in the bus transfers */
+struct wfx_io_class_stats {
+	u64 count;
+	u64 bytes;
+	u64 time_ns;
+	u64 max_ns;
+	struct wfx_hist latency; /* in us */
+};
+
+struct wfx_io_stats {
+	/* The bus lock does not serialize the transfers on every bus */
+	spinlock_t lock;
+	ktime_t start;
+	struct wfx_io_class_stats class[WFX_IO_NUM_CLASSES];
+};
+
+void wfx_io_stats_reset(struct wfx_dev *wdev);
+int wfx_io_stats_show(struct seq_file *seq, struct wfx_dev *wdev);
 
 /* Caution: in the functions below, 'buf' will used with a DMA. So, it must be kmalloc'd (do not use
  * stack allocated buffers). In doubt, enable CONFIG_DEBUG_SG to detect badly located buffer.
@@ -40,6 +40,10 @@
 #define WFX_PDS_TLV_TYPE 0x4450 // "PD" (Platform Data) in ascii little-endian
 #define WFX_PDS_MAX_CHUNK_SIZE 1500
 
+static bool recovery = true;
+module_param(recovery, bool, 0644);
+MODULE_PARM_DESC(recovery, "Reset and reconfigure the chip when it stops responding (default: true).");
+
 MODULE_DESCRIPTION("Silicon Labs 802.11 Wireless LAN driver for WF200");
 MODULE_AUTHOR("Jérôme Pouiller <jerome.pouiller@silabs.com>");
 MODULE_LICENSE("GPL");
@@ -177,10 +181,9 @@ bool wfx_api_older_than(struct wfx_dev *wdev, int major, int minor)
  * used to enter/leave a level of the tree (in a JSON fashion). PDS files can only been split
  * between root nodes.
  */
-int wfx_send_pds_legacy(struct wfx_dev *wdev, u8 *buf, size_t len)
+static int wfx_pds_compile_legacy(struct wfx_dev *wdev, const u8 *buf, size_t len, u8 *out)
 {
-	int ret;
-	int start = 0, brace_level = 0, i;
+	int start = 0, brace_level = 0, pos = 0, i;
 
 	for (i = 1; i < len - 1; i++) {
 		if (buf[i] == '{')
@@ -191,31 +194,18 @@ int wfx_send_pds_legacy(struct wfx_dev *wdev, u8 *buf, size_t len)
 			i++;
 			if (i - start + 1 > WFX_PDS_MAX_CHUNK_SIZE)
 				return -EFBIG;
-			buf[start] = '{';
-			buf[i] = 0;
-			dev_dbg(wdev->dev, "send PDS '%s}'\n", buf + start);
-			buf[i] = '}';
-			ret = wfx_hif_configuration(wdev, buf + start, i - start + 1);
-			if (ret > 0) {
-				dev_err(wdev->dev, "PDS bytes %d to %d: invalid data (unsupported options?)\n",
-					start, i);
-				return -EINVAL;
-			}
-			if (ret == -ETIMEDOUT) {
-				dev_err(wdev->dev, "PDS bytes %d to %d: chip didn't reply (corrupted file?)\n",
-					start, i);
-				return ret;
+			/* Separator between root nodes is replaced by braces */
+			if (out) {
+				put_unaligned_le16(i - start + 1, out + pos);
+				out[pos + 2] = '{';
+				memcpy(out + pos + 3, buf + start + 1, i - start - 1);
+				out[pos + 2 + i - start] = '}';
 			}
-			if (ret) {
-				dev_err(wdev->dev, "PDS bytes %d to %d: chip returned an unknown error\n",
-					start, i);
-				return -EIO;
-			}
-			buf[i] = ',';
+			pos += sizeof(__le16) + i - start + 1;
 			start = i;
 		}
 	}
-	return 0;
+	return pos;
 }
 
 /* The device needs data about the antenna configuration. This information in provided by PDS
@@ -224,14 +214,22 @@ int wfx_send_pds_legacy(struct wfx_dev *wdev, u8 *buf, size_t len)
  *   https://github.com/SiliconLabs/wfx-firmware/blob/master/PDS/README.md
  *
  * The PDS file is an array of Time-Length-Value structs.
+ *
+ * The file is compiled into the list of messages to send to the chip, so the result can be cached.
+ * Each message is prefixed by its length (__le16). If out is NULL, only return the size of the
+ * result.
  */
-int wfx_send_pds(struct wfx_dev *wdev, u8 *buf, size_t len)
+static int wfx_pds_compile(struct wfx_dev *wdev, const u8 *buf, size_t len, u8 *out)
 {
-	int ret, chunk_type, chunk_len, chunk_num = 0;
+	int chunk_type, chunk_len, chunk_num = 0, pos = 0;
 
-	if (*buf == '{')
-		return wfx_send_pds_legacy(wdev, buf, len);
+	if (len && *buf == '{')
+		return wfx_pds_compile_legacy(wdev, buf, len, out);
 	while (len > 0) {
+		if (len < 4) {
+			dev_err(wdev->dev, "PDS:%d: corrupted file\n", chunk_num);
+			return -EINVAL;
+		}
 		chunk_type = get_unaligned_le16(buf + 0);
 		chunk_len = get_unaligned_le16(buf + 2);
 		if (chunk_len < 4 || chunk_len > len) {
@@ -239,15 +237,34 @@ int wfx_send_pds(struct wfx_dev *wdev, u8 *buf, size_t len)
 			return -EINVAL;
 		}
 		if (chunk_type != WFX_PDS_TLV_TYPE) {
-			dev_info(wdev->dev, "PDS:%d: skip unknown data\n", chunk_num);
+			if (!out)
+				dev_info(wdev->dev, "PDS:%d: skip unknown data\n", chunk_num);
 			goto next;
 		}
-		if (chunk_len > WFX_PDS_MAX_CHUNK_SIZE)
+		if (!out && chunk_len > WFX_PDS_MAX_CHUNK_SIZE)
 			dev_warn(wdev->dev, "PDS:%d: unexpectly large chunk\n", chunk_num);
-		if (buf[4] != '{' || buf[chunk_len - 1] != '}')
+		if (!out && (buf[4] != '{' || buf[chunk_len - 1] != '}'))
 			dev_warn(wdev->dev, "PDS:%d: unexpected content\n", chunk_num);
+		if (out) {
+			put_unaligned_le16(chunk_len - 4, out + pos);
+			memcpy(out + pos + 2, buf + 4, chunk_len - 4);
+		}
+		pos += sizeof(__le16) + chunk_len - 4;
+next:
+		chunk_num++;
+		len -= chunk_len;
+		buf += chunk_len;
+	}
+	return pos;
+}
 
-		ret = wfx_hif_configuration(wdev, buf + 4, chunk_len - 4);
+static int wfx_send_pds_compiled(struct wfx_dev *wdev, const u8 *buf, size_t len)
+{
+	int ret, chunk_len, chunk_num = 0;
+
+	while (len > 0) {
+		chunk_len = get_unaligned_le16(buf);
+		ret = wfx_hif_configuration(wdev, buf + 2, chunk_len);
 		if (ret > 0) {
 			dev_err(wdev->dev, "PDS:%d: invalid data (unsupported options?)\n", chunk_num);
 			return -EINVAL;
@@ -260,35 +277,76 @@ int wfx_send_pds(struct wfx_dev *wdev, u8 *buf, size_t len)
 			dev_err(wdev->dev, "PDS:%d: chip returned an unknown error\n", chunk_num);
 			return -EIO;
 		}
-next:
 		chunk_num++;
-		len -= chunk_len;
-		buf += chunk_len;
+		len -= sizeof(__le16) + chunk_len;
+		buf += sizeof(__le16) + chunk_len;
 	}
 	return 0;
 }
 
+/* Return the compiled PDS allocated with kmalloc() or an ERR_PTR() */
+static u8 *wfx_pds_build(struct wfx_dev *wdev, const u8 *buf, size_t len, int *out_len)
+{
+	u8 *out;
+	int ret;
+
+	ret = wfx_pds_compile(wdev, buf, len, NULL);
+	if (ret < 0)
+		return ERR_PTR(ret);
+	out = kmalloc(ret, GFP_KERNEL);
+	if (!out)
+		return ERR_PTR(-ENOMEM);
+	*out_len = wfx_pds_compile(wdev, buf, len, out);
+	return out;
+}
+
+int wfx_send_pds(struct wfx_dev *wdev, const u8 *buf, size_t len)
+{
+	int ret, out_len;
+	u8 *out;
+
+	out = wfx_pds_build(wdev, buf, len, &out_len);
+	if (IS_ERR(out))
+		return PTR_ERR(out);
+	ret = wfx_send_pds_compiled(wdev, out, out_len);
+	kfree(out);
+	return ret;
+}
+
 static int wfx_send_pdata_pds(struct wfx_dev *wdev)
 {
-	int ret = 0;
+	struct wfx_fw_cache_entry *cached;
 	const struct firmware *pds;
-	u8 *tmp_buf;
+	int ret, out_len;
+	ktime_t start;
+	s64 load_us;
+	u8 *out;
+
+	cached = wfx_fw_cache_get(wdev->pdata.file_pds, WFX_FW_CACHE_PDS);
+	if (cached) {
+		ret = wfx_send_pds_compiled(wdev, cached->data, cached->len);
+		wfx_fw_cache_put(cached);
+		return ret;
+	}
 
+	start = ktime_get();
 	ret = request_firmware(&pds, wdev->pdata.file_pds, wdev->dev);
 	if (ret) {
 		dev_err(wdev->dev, "can't load antenna parameters (PDS file %s). The device may be unstable.\n",
 			wdev->pdata.file_pds);
 		return ret;
 	}
-	tmp_buf = kmemdup(pds->data, pds->size, GFP_KERNEL);
-	if (!tmp_buf) {
-		ret = -ENOMEM;
-		goto release_fw;
-	}
-	ret = wfx_send_pds(wdev, tmp_buf, pds->size);
-	kfree(tmp_buf);
-release_fw:
+	out = wfx_pds_build(wdev, pds->data, pds->size, &out_len);
 	release_firmware(pds);
+	if (IS_ERR(out))
+		return PTR_ERR(out);
+	load_us = ktime_us_delta(ktime_get(), start);
+	ret = wfx_send_pds_compiled(wdev, out, out_len);
+	/* Do not cache a file rejected by the chip */
+	if (!ret)
+		wfx_fw_cache_put(wfx_fw_cache_add(wdev->pdata.file_pds, WFX_FW_CACHE_PDS, out,
+						  out_len, 0, load_us));
+	kfree(out);
 	return ret;
 }
 
@@ -383,10 +441,14 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 	mutex_init(&wdev->tx_power_loop_info_lock);
 	init_completion(&wdev->firmware_ready);
 	INIT_DELAYED_WORK(&wdev->cooling_timeout_work, wfx_cooling_timeout_work);
+	/* Recovery is only possible once the device is registered */
+	WRITE_ONCE(wdev->recovery_blocked, true);
 	skb_queue_head_init(&wdev->tx_pending);
 	init_waitqueue_head(&wdev->tx_dequeue);
 	wfx_init_hif_cmd(&wdev->hif_cmd);
 	wdev->force_ps_timeout = -1;
+	spin_lock_init(&wdev->io_stats.lock);
+	wdev->io_stats.start = ktime_get();
 
 	if (devm_add_action_or_reset(dev, wfx_free_common, wdev))
 		return NULL;
@@ -398,35 +460,12 @@ err:
 	return NULL;
 }
 
-int wfx_probe(struct wfx_dev *wdev)
+static int wfx_wait_startup(struct wfx_dev *wdev)
 {
-	int i;
-	int err;
-	struct gpio_desc *gpio_saved;
-
-	/* During first part of boot, gpio_wakeup cannot yet been used. So prevent bh() to touch
-	 * it.
-	 */
-	gpio_saved = wdev->pdata.gpio_wakeup;
-	wdev->pdata.gpio_wakeup = NULL;
-	wdev->poll_irq = true;
-
-	wdev->bh_wq = alloc_workqueue("wfx_bh_wq", WQ_HIGHPRI, 0);
-	if (!wdev->bh_wq)
-		return -ENOMEM;
-
-	wfx_bh_register(wdev);
-
-	err = wfx_init_device(wdev);
-	if (err)
-		goto bh_unregister;
-
 	wfx_bh_poll_irq(wdev);
-	err = wait_for_completion_timeout(&wdev->firmware_ready, 1 * HZ);
-	if (err == 0) {
+	if (!wait_for_completion_timeout(&wdev->firmware_ready, 1 * HZ)) {
 		dev_err(wdev->dev, "timeout while waiting for startup indication\n");
-		err = -ETIMEDOUT;
-		goto bh_unregister;
+		return -ETIMEDOUT;
 	}
 
 	/* FIXME: fill wiphy::hw_version */
@@ -445,15 +484,26 @@ int wfx_probe(struct wfx_dev *wdev)
 	if (wfx_api_older_than(wdev, 1, 0)) {
 		dev_err(wdev->dev, "unsupported firmware API version (expect 1 while firmware returns %d)\n",
 			wdev->hw_caps.api_version_major);
-		err = -EOPNOTSUPP;
-		goto bh_unregister;
+		return -EOPNOTSUPP;
 	}
+	return 0;
+}
+
+static int wfx_start_secure_link(struct wfx_dev *wdev)
+{
+	int err;
 
 	err = wfx_sl_init(wdev);
 	if (err && wdev->hw_caps.link_mode == SEC_LINK_ENFORCED) {
 		dev_err(wdev->dev, "chip require secure_link, but can't negotiate it\n");
-		goto bh_unregister;
+		return err;
 	}
+	return 0;
+}
+
+static int wfx_send_configuration(struct wfx_dev *wdev)
+{
+	int err;
 
 	if (wdev->hw_caps.region_sel_mode) {
 		wdev->hw->wiphy->regulatory_flags |= REGULATORY_DISABLE_BEACON_HINTS;
@@ -467,18 +517,49 @@ int wfx_probe(struct wfx_dev *wdev)
 	dev_dbg(wdev->dev, "sending configuration file %s\n", wdev->pdata.file_pds);
 	err = wfx_send_pdata_pds(wdev);
 	if (err < 0 && err != -ENOENT)
-		goto bh_unregister;
+		return err;
+	return 0;
+}
 
-	wdev->poll_irq = false;
-	err = wdev->hwbus_ops->irq_subscribe(wdev->hwbus_priv);
-	if (err)
-		goto bh_unregister;
+/* Initialization of the chip is split in stages in order to measure each of them. During these
+ * stages, the IRQ is not yet available.
+ */
+static const struct {
+	const char *name;
+	int (*run)(struct wfx_dev *wdev);
+} wfx_init_stages[] = {
+	{ "firmware",    wfx_init_device },
+	{ "startup",     wfx_wait_startup },
+	{ "secure link", wfx_start_secure_link },
+	{ "PDS",         wfx_send_configuration },
+};
 
-	err = wfx_hif_use_multi_tx_conf(wdev, true);
-	if (err)
-		dev_err(wdev->dev, "misconfigured IRQ?\n");
+static int wfx_init_chip(struct wfx_dev *wdev)
+{
+	char report[128];
+	int i, err, pos = 0;
+	ktime_t start;
+	s64 delta;
+
+	for (i = 0; i < ARRAY_SIZE(wfx_init_stages); i++) {
+		start = ktime_get();
+		err = wfx_init_stages[i].run(wdev);
+		delta = ktime_us_delta(ktime_get(), start);
+		if (err) {
+			dev_err(wdev->dev, "initialization failed during stage \"%s\" (after %lldus)\n",
+				wfx_init_stages[i].name, delta);
+			return err;
+		}
+		pos += scnprintf(report + pos, sizeof(report) - pos, "%s%s: %lldms",
+				 i ? ", " : "", wfx_init_stages[i].name,
+				 div_s64(delta, USEC_PER_MSEC));
+	}
+	dev_info(wdev->dev, "chip initialized (%s)\n", report);
+	return 0;
+}
 
-	wdev->pdata.gpio_wakeup = gpio_saved;
+static void wfx_set_power_mode(struct wfx_dev *wdev)
+{
 	if (wdev->pdata.gpio_wakeup) {
 		dev_dbg(wdev->dev, "enable 'quiescent' power mode with wakeup GPIO and PDS file %s\n",
 			wdev->pdata.file_pds);
@@ -488,6 +569,159 @@ int wfx_probe(struct wfx_dev *wdev)
 	} else {
 		wfx_hif_set_operational_mode(wdev, HIF_OP_POWER_MODE_DOZE);
 	}
+}
+
+/* Recovery reuses the cached firmware and PDS, so it is far faster than the probe. Once the chip
+ * is running again, ieee80211_restart_hw() asks mac80211 to replay the configuration of the
+ * interfaces, the stations, the keys and the queues.
+ */
+static void wfx_recovery_work(struct work_struct *work)
+{
+	struct wfx_dev *wdev = container_of(work, struct wfx_dev, recovery_work);
+	struct gpio_desc *gpio_saved;
+	struct wfx_vif *wvif;
+	ktime_t start;
+	s64 delta;
+	int err;
+
+	start = ktime_get();
+	dev_warn(wdev->dev, "chip is frozen, trying to recover it\n");
+	/* Let the works started before the freeze finish. They fail quickly since chip_frozen is
+	 * set.
+	 */
+	wvif = NULL;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		flush_work(&wvif->scan_work);
+		flush_work(&wvif->remain_on_channel_work);
+		cancel_delayed_work_sync(&wvif->update_tim_work);
+		wfx_update_pm_stop(wvif);
+		cancel_delayed_work_sync(&wvif->set_pm_mode_timeout_work);
+		cancel_work_sync(&wvif->tx_policy_upload_work);
+		cancel_delayed_work_sync(&wvif->beacon_loss_work);
+	}
+	if (cancel_delayed_work_sync(&wdev->cooling_timeout_work))
+		wfx_tx_unlock(wdev);
+	wfx_tx_lock(wdev);
+	mutex_lock(&wdev->conf_mutex);
+	wdev->hwbus_ops->irq_unsubscribe(wdev->hwbus_priv);
+	wfx_flush(wdev->hw, NULL, GENMASK(IEEE80211_NUM_ACS - 1, 0), true);
+	/* A bh queued before irq_unsubscribe() may still encode or decode with the Secure Link
+	 * context
+	 */
+	cancel_work_sync(&wdev->hif.bh);
+	wfx_sl_deinit(wdev);
+
+	err = wdev->hwbus_ops->reset(wdev->hwbus_priv);
+	if (err)
+		goto err_irq;
+	wfx_bh_reset(wdev);
+	reinit_completion(&wdev->hif_cmd.ready);
+	reinit_completion(&wdev->hif_cmd.done);
+	reinit_completion(&wdev->firmware_ready);
+
+	gpio_saved = wdev->pdata.gpio_wakeup;
+	wdev->pdata.gpio_wakeup = NULL;
+	wdev->poll_irq = true;
+	WRITE_ONCE(wdev->chip_frozen, false);
+	err = wfx_init_chip(wdev);
+	wdev->poll_irq = false;
+	wdev->pdata.gpio_wakeup = gpio_saved;
+	if (err)
+		goto err_irq;
+	err = wdev->hwbus_ops->irq_subscribe(wdev->hwbus_priv);
+	if (err)
+		goto err;
+	if (wfx_hif_use_multi_tx_conf(wdev, true))
+		dev_err(wdev->dev, "misconfigured IRQ?\n");
+	wfx_set_power_mode(wdev);
+
+	/* mac80211 will call wfx_add_interface() and wfx_set_key() again */
+	memset(wdev->vif, 0, sizeof(wdev->vif));
+	wdev->key_map = 0;
+	delta = ktime_us_delta(ktime_get(), start);
+	wdev->num_recoveries++;
+	wdev->last_recovery_us = delta;
+	wdev->max_recovery_us = max(wdev->max_recovery_us, delta);
+	WRITE_ONCE(wdev->recovery_blocked, false);
+	mutex_unlock(&wdev->conf_mutex);
+	wfx_tx_unlock(wdev);
+	dev_info(wdev->dev, "chip recovered in %lldms (%u recoveries so far)\n",
+		 div_s64(delta, USEC_PER_MSEC), wdev->num_recoveries);
+	ieee80211_restart_hw(wdev->hw);
+	return;
+
+err_irq:
+	/* Keep wfx_release() balanced */
+	wdev->hwbus_ops->irq_subscribe(wdev->hwbus_priv);
+err:
+	/* Do not loop on a chip that cannot be recovered. Traffic stays blocked. */
+	WRITE_ONCE(wdev->chip_frozen, true);
+	wdev->num_recovery_failures++;
+	mutex_unlock(&wdev->conf_mutex);
+	dev_err(wdev->dev, "cannot recover chip: %d\n", err);
+}
+
+bool wfx_chip_can_recover(struct wfx_dev *wdev)
+{
+	return recovery && wdev->hwbus_ops->reset;
+}
+
+void wfx_chip_set_frozen(struct wfx_dev *wdev)
+{
+	WRITE_ONCE(wdev->chip_frozen, true);
+	if (!recovery || READ_ONCE(wdev->recovery_blocked))
+		return;
+	if (!wdev->hwbus_ops->reset) {
+		dev_err(wdev->dev, "chip is frozen and the bus cannot reset it\n");
+		WRITE_ONCE(wdev->recovery_blocked, true);
+		return;
+	}
+	WRITE_ONCE(wdev->recovery_blocked, true);
+	schedule_work(&wdev->recovery_work);
+}
+
+/* Both bus drivers ask for asynchronous probe, so the initialization of the chips runs in
+ * parallel and does not block the boot.
+ */
+int wfx_probe(struct wfx_dev *wdev)
+{
+	int i;
+	int err;
+	struct gpio_desc *gpio_saved;
+	ktime_t start;
+
+	/* During first part of boot, gpio_wakeup cannot yet been used. So prevent bh() to touch
+	 * it.
+	 */
+	gpio_saved = wdev->pdata.gpio_wakeup;
+	wdev->pdata.gpio_wakeup = NULL;
+	wdev->poll_irq = true;
+
+	wdev->bh_wq = alloc_workqueue("wfx_bh_wq", WQ_HIGHPRI, 0);
+	if (!wdev->bh_wq)
+		return -ENOMEM;
+
+	INIT_WORK(&wdev->recovery_work, wfx_recovery_work);
+
+	wfx_bh_register(wdev);
+	wfx_sl_register(wdev);
+
+	err = wfx_init_chip(wdev);
+	if (err)
+		goto bh_unregister;
+
+	start = ktime_get();
+	wdev->poll_irq = false;
+	err = wdev->hwbus_ops->irq_subscribe(wdev->hwbus_priv);
+	if (err)
+		goto bh_unregister;
+
+	err = wfx_hif_use_multi_tx_conf(wdev, true);
+	if (err)
+		dev_err(wdev->dev, "misconfigured IRQ?\n");
+
+	wdev->pdata.gpio_wakeup = gpio_saved;
+	wfx_set_power_mode(wdev);
 
 	for (i = 0; i < ARRAY_SIZE(wdev->addresses); i++) {
 #if (KERNEL_VERSION(5, 13, 0) > LINUX_VERSION_CODE)
@@ -528,6 +762,8 @@ int wfx_probe(struct wfx_dev *wdev)
 	if (err)
 		goto ieee80211_unregister;
 
+	dev_dbg(wdev->dev, "device registered after %lldus\n", ktime_us_delta(ktime_get(), start));
+	WRITE_ONCE(wdev->recovery_blocked, false);
 	return 0;
 
 ieee80211_unregister:
@@ -535,6 +771,7 @@ ieee80211_unregister:
 irq_unsubscribe:
 	wdev->hwbus_ops->irq_unsubscribe(wdev->hwbus_priv);
 bh_unregister:
+	wfx_sl_unregister(wdev);
 	wfx_bh_unregister(wdev);
 	destroy_workqueue(wdev->bh_wq);
 	return err;
@@ -542,11 +779,14 @@ bh_unregister:
 
 void wfx_release(struct wfx_dev *wdev)
 {
+	WRITE_ONCE(wdev->recovery_blocked, true);
+	cancel_work_sync(&wdev->recovery_work);
 	ieee80211_unregister_hw(wdev->hw);
 	wfx_hif_shutdown(wdev);
 	wdev->hwbus_ops->irq_unsubscribe(wdev->hwbus_priv);
 	wfx_bh_unregister(wdev);
 	wfx_sl_deinit(wdev);
+	wfx_sl_unregister(wdev);
 	destroy_workqueue(wdev->bh_wq);
 }
 
@@ -556,14 +796,37 @@ static int wfx_core_init(void)
 static int __init wfx_core_init(void)
 #endif
 {
-	int ret = 0;
+	int ret;
 
 	pr_info("wfx: Silicon Labs " WFX_LABEL "\n");
 
-	if (IS_ENABLED(CONFIG_SPI))
+	if (IS_ENABLED(CONFIG_SPI)) {
 		ret = spi_register_driver(&wfx_spi_driver);
-	if (IS_ENABLED(CONFIG_MMC) && !ret)
+		if (ret)
+			return ret;
+	}
+	if (IS_ENABLED(CONFIG_MMC)) {
 		ret = sdio_register_driver(&wfx_sdio_driver);
+		if (ret)
+			goto err_spi;
+	}
+#ifdef CONFIG_WFX_EMUL
+	ret = wfx_emul_register();
+	if (ret)
+		goto err_sdio;
+#endif
+	return 0;
+
+#ifdef CONFIG_WFX_EMUL
+err_sdio:
+	if (IS_ENABLED(CONFIG_MMC))
+		sdio_unregister_driver(&wfx_sdio_driver);
+#endif
+err_spi:
+	if (IS_ENABLED(CONFIG_SPI))
+		spi_unregister_driver(&wfx_spi_driver);
+	/* The devices probed in the meantime may have filled the firmware cache */
+	wfx_fw_cache_flush();
 	return ret;
 }
 module_init(wfx_core_init);
@@ -574,9 +837,13 @@ static void wfx_core_exit(void)
 static void __exit wfx_core_exit(void)
 #endif
 {
+#ifdef CONFIG_WFX_EMUL
+	wfx_emul_unregister();
+#endif
 	if (IS_ENABLED(CONFIG_MMC))
 		sdio_unregister_driver(&wfx_sdio_driver);
 	if (IS_ENABLED(CONFIG_SPI))
 		spi_unregister_driver(&wfx_spi_driver);
+	wfx_fw_cache_flush();
 }
 module_exit(wfx_core_exit);
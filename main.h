@@ -52,8 +52,10 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 
 int wfx_probe(struct wfx_dev *wdev);
 void wfx_release(struct wfx_dev *wdev);
+bool wfx_chip_can_recover(struct wfx_dev *wdev);
+void wfx_chip_set_frozen(struct wfx_dev *wdev);
 
 bool wfx_api_older_than(struct wfx_dev *wdev, int major, int minor);
-int wfx_send_pds(struct wfx_dev *wdev, u8 *buf, size_t len);
+int wfx_send_pds(struct wfx_dev *wdev, const u8 *buf, size_t len);
 
 #endif
@@ -603,6 +603,24 @@ int mbedtls_internal_aes_encrypt( mbedtls_aes_context *ctx,
                                   const unsigned char input[16],
                                   unsigned char output[16] );
 
+/**
+ * \brief           Internal AES encryption of several independent blocks
+ *                  (e.g. counter blocks). Hardware implementations process
+ *                  the blocks in parallel.
+ *
+ * \param ctx       The AES context to use for encryption.
+ * \param nblocks   The number of 16-byte blocks.
+ * \param input     The plaintext blocks.
+ * \param output    The output (ciphertext) blocks. It may be equal to
+ *                  \p input but must not overlap it otherwise.
+ *
+ * \return          \c 0 on success.
+ */
+int mbedtls_internal_aes_encrypt_blocks( mbedtls_aes_context *ctx,
+                                         size_t nblocks,
+                                         const unsigned char *input,
+                                         unsigned char *output );
+
 /**
  * \brief           Internal AES block decryption function. This is only
  *                  exposed to allow overriding it using see
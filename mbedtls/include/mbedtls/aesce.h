@@ -0,0 +1,111 @@
+/**
+ * \file aesce.h
+ *
+ * \brief ARMv8 Cryptography Extensions for hardware AES acceleration on
+ *        AArch64 processors
+ *
+ * \warning These functions are only for internal use by other library
+ *          functions; you must not call them directly.
+ */
+/*
+ *  Copyright (C) 2020, Silicon Laboratories, Inc., All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_AESCE_H
+#define MBEDTLS_AESCE_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include "aes.h"
+
+#if defined(MBEDTLS_HAVE_ASM) && defined(__GNUC__) && \
+    defined(__aarch64__) && ! defined(MBEDTLS_HAVE_ARM64)
+#define MBEDTLS_HAVE_ARM64
+#endif
+
+#if defined(MBEDTLS_HAVE_ARM64)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Internal function to detect the AES instructions of the
+ *                 ARMv8 Cryptography Extensions.
+ *
+ * \note           This function is only for internal use by other library
+ *                 functions; you must not call it directly.
+ *
+ * \note           In the Linux kernel, it also returns 0 if the SIMD
+ *                 registers cannot be used in the current context.
+ *
+ * \return         1 if the instructions can be used, 0 otherwise
+ */
+int mbedtls_aesce_has_support( void );
+
+/**
+ * \brief          Internal ARMv8-CE AES-ECB block encryption and decryption
+ *
+ * \note           This function is only for internal use by other library
+ *                 functions; you must not call it directly.
+ *
+ * \note           The round keys are the ones computed by
+ *                 mbedtls_aes_setkey_enc() and mbedtls_aes_setkey_dec().
+ *
+ * \param ctx      AES context
+ * \param mode     MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param input    16-byte input block
+ * \param output   16-byte output block
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                             int mode,
+                             const unsigned char input[16],
+                             unsigned char output[16] );
+
+/**
+ * \brief          Internal ARMv8-CE encryption of several independent
+ *                 blocks. Blocks are processed 4 by 4 to fill the pipeline
+ *                 of the AES unit.
+ *
+ * \note           This function is only for internal use by other library
+ *                 functions; you must not call it directly.
+ *
+ * \param ctx      AES context
+ * \param nblocks  Number of 16-byte blocks
+ * \param input    Input blocks
+ * \param output   Output blocks (may be equal to input)
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesce_encrypt_blocks( mbedtls_aes_context *ctx,
+                                  size_t nblocks,
+                                  const unsigned char *input,
+                                  unsigned char *output );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBEDTLS_HAVE_ARM64 */
+
+#endif /* MBEDTLS_AESCE_H */
@@ -59,6 +59,9 @@ extern "C" {
  * \param what     The feature to detect
  *                 (MBEDTLS_AESNI_AES or MBEDTLS_AESNI_CLMUL)
  *
+ * \note           In the Linux kernel, it also returns 0 if the FPU
+ *                 registers cannot be used in the current context.
+ *
  * \return         1 if CPU has support for the feature, 0 otherwise
  */
 int mbedtls_aesni_has_support( unsigned int what );
@@ -81,6 +84,26 @@ int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
                              const unsigned char input[16],
                              unsigned char output[16] );
 
+/**
+ * \brief          Internal AES-NI encryption of several independent blocks.
+ *                 Blocks are processed 4 by 4 to fill the pipeline of the
+ *                 AES unit.
+ *
+ * \note           This function is only for internal use by other library
+ *                 functions; you must not call it directly.
+ *
+ * \param ctx      AES context
+ * \param nblocks  Number of 16-byte blocks
+ * \param input    Input blocks
+ * \param output   Output blocks (may be equal to input)
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesni_encrypt_blocks( mbedtls_aes_context *ctx,
+                                  size_t nblocks,
+                                  const unsigned char *input,
+                                  unsigned char *output );
+
 /**
  * \brief          Internal GCM multiplication: c = a * b in GF(2^128)
  *
@@ -113,6 +136,7 @@ void mbedtls_aesni_inverse_key( unsigned char *invkey,
                                 const unsigned char *fwdkey,
                                 int nr );
 
+#if !defined(__KERNEL__)
 /**
  * \brief           Internal key expansion for encryption
  *
@@ -128,6 +152,7 @@ void mbedtls_aesni_inverse_key( unsigned char *invkey,
 int mbedtls_aesni_setkey_enc( unsigned char *rk,
                               const unsigned char *key,
                               size_t bits );
+#endif /* !__KERNEL__ */
 
 #ifdef __cplusplus
 }
@@ -193,11 +193,35 @@
 #define MULADDC_STOP                        \
         : "+c" (c), "+D" (d), "+S" (s)      \
         : "b" (b)                           \
-        : "rax", "rdx", "r8"                \
+        : "rax", "rdx", "r8", "cc", "memory" \
     );
 
 #endif /* AMD64 */
 
+#if defined(__aarch64__)
+
+#define MULADDC_INIT                        \
+    asm(
+
+#define MULADDC_CORE                        \
+        "ldr    x4, [%2], #8\n"             \
+        "ldr    x5, [%1]\n"                 \
+        "mul    x6, x4, %3\n"               \
+        "umulh  x7, x4, %3\n"               \
+        "adds   x5, x5, x6\n"               \
+        "adc    x7, x7, xzr\n"              \
+        "adds   x5, x5, %0\n"               \
+        "adc    %0, x7, xzr\n"              \
+        "str    x5, [%1], #8\n"
+
+#define MULADDC_STOP                        \
+        : "+r" (c), "+r" (d), "+r" (s)      \
+        : "r" (b)                           \
+        : "x4", "x5", "x6", "x7", "cc", "memory" \
+    );
+
+#endif /* Aarch64 */
+
 #if defined(__mc68020__) || defined(__mcpu32__)
 
 #define MULADDC_INIT                    \
@@ -54,8 +54,11 @@
  *
  * Required by:
  *      MBEDTLS_AESNI_C
+ *      MBEDTLS_AESCE_C
  *      MBEDTLS_PADLOCK_C
  *
+ * The wfx Makefile defines it on arm64 and x86_64 (CONFIG_WFX_MBEDTLS_ASM).
+ *
  * Comment to disable the use of assembly code.
  */
 //#define MBEDTLS_HAVE_ASM
@@ -760,6 +763,21 @@
  */
 //#define MBEDTLS_ECP_NIST_OPTIM
 
+/**
+ * \def MBEDTLS_ECP_X25519_FAST
+ *
+ * Use a dedicated implementation of X25519 (RFC 7748) for scalar
+ * multiplications on Curve25519. It uses fixed-size field elements on the
+ * stack instead of the generic bignum code and runs in constant time. It is
+ * about 15 times faster when the compiler provides 128-bit integers and about
+ * twice faster otherwise.
+ *
+ * Requires: MBEDTLS_ECP_DP_CURVE25519_ENABLED
+ *
+ * Comment this macro to use the generic Montgomery ladder.
+ */
+#define MBEDTLS_ECP_X25519_FAST
+
 /**
  * \def MBEDTLS_ECP_RESTARTABLE
  *
@@ -1781,8 +1799,31 @@
  * Requires: MBEDTLS_HAVE_ASM
  *
  * This modules adds support for the AES-NI instructions on x86-64
+ *
+ * Enabled when MBEDTLS_HAVE_ASM is set. In the kernel, the FPU context is
+ * saved around the instructions and the feature is detected at runtime.
+ */
+#if defined(MBEDTLS_HAVE_ASM)
+#define MBEDTLS_AESNI_C
+#endif
+
+/**
+ * \def MBEDTLS_AESCE_C
+ *
+ * Enable ARMv8 Cryptography Extensions support on AArch64.
+ *
+ * Module:  library/aesce.c
+ * Caller:  library/aes.c
+ *
+ * Requires: MBEDTLS_HAVE_ASM
+ *
+ * This modules adds support for the AESE/AESD instructions on AArch64. The
+ * instructions are used only if the CPU provides them (and, in the kernel,
+ * if the SIMD registers can be used in the current context).
  */
-//#define MBEDTLS_AESNI_C
+#if defined(MBEDTLS_HAVE_ASM)
+#define MBEDTLS_AESCE_C
+#endif
 
 /**
  * \def MBEDTLS_AES_C
@@ -3321,7 +3362,16 @@
 
 #include "mbedtls/check_config.h"
 
-/* https://github.com/ARMmbed/mbedtls/issues/137#issuecomment-124117580 */
+/* https://github.com/ARMmbed/mbedtls/issues/137#issuecomment-124117580
+ *
+ * 64-bit limbs are only worth it with the assembly multiply-accumulate of
+ * bn_mul.h. MBEDTLS_NO_UDBL_DIVISION (see above) avoids the 128-bit divisions
+ * that the kernel does not provide.
+ */
+#if defined(MBEDTLS_HAVE_ASM) && ( defined(__aarch64__) || defined(__x86_64__) )
+#define MBEDTLS_HAVE_INT64
+#else
 #define MBEDTLS_HAVE_INT32
+#endif
 
 #endif /* MBEDTLS_CONFIG_H */
@@ -44,6 +44,9 @@
 #if defined(MBEDTLS_AESNI_C)
 #include "mbedtls/aesni.h"
 #endif
+#if defined(MBEDTLS_AESCE_C)
+#include "mbedtls/aesce.h"
+#endif
 
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
@@ -588,7 +591,7 @@ int mbedtls_aes_setkey_enc( mbedtls_aes_context *ctx, const unsigned char *key,
 #endif
     ctx->rk = RK = ctx->buf;
 
-#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64) && !defined(__KERNEL__)
     if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
         return( mbedtls_aesni_setkey_enc( (unsigned char *) ctx->rk, key, keybits ) );
 #endif
@@ -1042,6 +1045,11 @@ int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
         return( mbedtls_aesni_crypt_ecb( ctx, mode, input, output ) );
 #endif
 
+#if defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_HAVE_ARM64)
+    if( mbedtls_aesce_has_support() )
+        return( mbedtls_aesce_crypt_ecb( ctx, mode, input, output ) );
+#endif
+
 #if defined(MBEDTLS_PADLOCK_C) && defined(MBEDTLS_HAVE_X86)
     if( aes_padlock_ace )
     {
@@ -1060,6 +1068,40 @@ int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
         return( mbedtls_internal_aes_decrypt( ctx, input, output ) );
 }
 
+/*
+ * AES-ECB encryption of several independent blocks
+ */
+int mbedtls_internal_aes_encrypt_blocks( mbedtls_aes_context *ctx,
+                                         size_t nblocks,
+                                         const unsigned char *input,
+                                         unsigned char *output )
+{
+    int ret;
+
+    AES_VALIDATE_RET( ctx != NULL );
+    AES_VALIDATE_RET( nblocks == 0 || input != NULL );
+    AES_VALIDATE_RET( nblocks == 0 || output != NULL );
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+    if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
+        return( mbedtls_aesni_encrypt_blocks( ctx, nblocks, input, output ) );
+#endif
+
+#if defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_HAVE_ARM64)
+    if( mbedtls_aesce_has_support() )
+        return( mbedtls_aesce_encrypt_blocks( ctx, nblocks, input, output ) );
+#endif
+
+    for( ; nblocks > 0; nblocks--, input += 16, output += 16 )
+    {
+        ret = mbedtls_aes_crypt_ecb( ctx, MBEDTLS_AES_ENCRYPT, input, output );
+        if( ret != 0 )
+            return( ret );
+    }
+
+    return( 0 );
+}
+
 #if defined(MBEDTLS_CIPHER_MODE_CBC)
 /*
  * AES-CBC buffer encryption/decryption
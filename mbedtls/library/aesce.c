@@ -0,0 +1,215 @@
+/*
+ *  ARMv8 Cryptography Extensions support functions
+ *
+ *  Copyright (C) 2020, Silicon Laboratories, Inc., All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+/*
+ * [ARMv8-ARM] ARM Architecture Reference Manual ARMv8, for ARMv8-A
+ *             architecture profile, sections C7.2.3 to C7.2.6 (AESD, AESE,
+ *             AESIMC and AESMC).
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AESCE_C)
+
+#include "mbedtls/aesce.h"
+
+#if defined(MBEDTLS_HAVE_ARM64)
+
+#if defined(__KERNEL__)
+#include <linux/version.h>
+#include <linux/cpufeature.h>
+#include <asm/neon.h>
+#if (KERNEL_VERSION(4, 11, 0) > LINUX_VERSION_CODE)
+#include <linux/hardirq.h>
+#define may_use_simd() ( !in_interrupt() )
+#else
+#include <asm/simd.h>
+#endif
+
+/*
+ * The kernel is built without the SIMD registers, so they must not appear in
+ * clobber lists. kernel_neon_begin() saves them for us.
+ */
+#define AESCE_BEGIN()           kernel_neon_begin()
+#define AESCE_END()             kernel_neon_end()
+#define AESCE_CLOBBER( reg )
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+#define AESCE_BEGIN()
+#define AESCE_END()
+#define AESCE_CLOBBER( reg )    , reg
+#else
+#define AESCE_BEGIN()
+#define AESCE_END()
+#define AESCE_CLOBBER( reg )    , reg
+#endif
+
+#ifndef asm
+#define asm __asm
+#endif
+
+/*
+ * ARMv8-CE support detection routine
+ */
+int mbedtls_aesce_has_support( void )
+{
+#if defined(__KERNEL__)
+    return( cpu_have_feature( cpu_feature( AES ) ) && may_use_simd() );
+#elif defined(__linux__)
+    static int done = 0;
+    static int c = 0;
+
+    if( ! done )
+    {
+        c = ( getauxval( AT_HWCAP ) & HWCAP_AES ) != 0;
+        done = 1;
+    }
+
+    return( c );
+#else
+    return( 0 );
+#endif
+}
+
+/*
+ * ARMv8-CE AES-ECB block en(de)cryption
+ *
+ * AESE/AESD do AddRoundKey, (Inv)ShiftRows and (Inv)SubBytes, so the last
+ * round key is added with a plain EOR. The decryption round keys computed by
+ * mbedtls_aes_setkey_dec() are already in the form expected by AESD (the
+ * equivalent inverse cipher).
+ *
+ * Round keys are loaded as 32-bit words, so they are correct regardless of
+ * the endianness.
+ */
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                     int mode,
+                     const unsigned char input[16],
+                     unsigned char output[16] )
+{
+    const uint32_t *rk = ctx->rk;
+    unsigned int nr = ctx->nr - 1;
+
+    AESCE_BEGIN();
+    if( mode == MBEDTLS_AES_ENCRYPT )
+        asm volatile( ".arch armv8-a+crypto                  \n\t"
+                      "ld1       {v0.16b}, [%2]              \n\t" // load input
+                      "ld1       {v1.4s}, [%0], #16          \n\t" // load round key 0
+                      "1:                                    \n\t"
+                      "aese      v0.16b, v1.16b              \n\t" // do round
+                      "aesmc     v0.16b, v0.16b              \n\t"
+                      "ld1       {v1.4s}, [%0], #16          \n\t" // load next round key
+                      "subs      %w1, %w1, #1                \n\t" // loop
+                      "b.ne      1b                          \n\t"
+                      "aese      v0.16b, v1.16b              \n\t" // last round
+                      "ld1       {v1.4s}, [%0]               \n\t"
+                      "eor       v0.16b, v0.16b, v1.16b      \n\t"
+                      "st1       {v0.16b}, [%3]              \n\t" // export output
+                      : "+r" (rk), "+r" (nr)
+                      : "r" (input), "r" (output)
+                      : "memory", "cc" AESCE_CLOBBER( "v0" ) AESCE_CLOBBER( "v1" ) );
+    else
+        asm volatile( ".arch armv8-a+crypto                  \n\t"
+                      "ld1       {v0.16b}, [%2]              \n\t"
+                      "ld1       {v1.4s}, [%0], #16          \n\t"
+                      "1:                                    \n\t"
+                      "aesd      v0.16b, v1.16b              \n\t"
+                      "aesimc    v0.16b, v0.16b              \n\t"
+                      "ld1       {v1.4s}, [%0], #16          \n\t"
+                      "subs      %w1, %w1, #1                \n\t"
+                      "b.ne      1b                          \n\t"
+                      "aesd      v0.16b, v1.16b              \n\t"
+                      "ld1       {v1.4s}, [%0]               \n\t"
+                      "eor       v0.16b, v0.16b, v1.16b      \n\t"
+                      "st1       {v0.16b}, [%3]              \n\t"
+                      : "+r" (rk), "+r" (nr)
+                      : "r" (input), "r" (output)
+                      : "memory", "cc" AESCE_CLOBBER( "v0" ) AESCE_CLOBBER( "v1" ) );
+    AESCE_END();
+
+    return( 0 );
+}
+
+/*
+ * ARMv8-CE encryption of several independent blocks. AESE/AESMC are
+ * pipelined, so 4 interleaved blocks take about the same time as one.
+ */
+int mbedtls_aesce_encrypt_blocks( mbedtls_aes_context *ctx,
+                     size_t nblocks,
+                     const unsigned char *input,
+                     unsigned char *output )
+{
+    const uint32_t *rk;
+    unsigned int nr;
+
+    AESCE_BEGIN();
+    for( ; nblocks >= 4; nblocks -= 4, input += 64, output += 64 )
+    {
+        rk = ctx->rk;
+        nr = ctx->nr - 1;
+        asm volatile( ".arch armv8-a+crypto                  \n\t"
+                      "ld1       {v0.16b-v3.16b}, [%2]       \n\t" // load input
+                      "ld1       {v4.4s}, [%0], #16          \n\t" // load round key 0
+                      "1:                                    \n\t"
+                      "aese      v0.16b, v4.16b              \n\t" // do round
+                      "aesmc     v0.16b, v0.16b              \n\t"
+                      "aese      v1.16b, v4.16b              \n\t"
+                      "aesmc     v1.16b, v1.16b              \n\t"
+                      "aese      v2.16b, v4.16b              \n\t"
+                      "aesmc     v2.16b, v2.16b              \n\t"
+                      "aese      v3.16b, v4.16b              \n\t"
+                      "aesmc     v3.16b, v3.16b              \n\t"
+                      "ld1       {v4.4s}, [%0], #16          \n\t" // load next round key
+                      "subs      %w1, %w1, #1                \n\t" // loop
+                      "b.ne      1b                          \n\t"
+                      "aese      v0.16b, v4.16b              \n\t" // last round
+                      "aese      v1.16b, v4.16b              \n\t"
+                      "aese      v2.16b, v4.16b              \n\t"
+                      "aese      v3.16b, v4.16b              \n\t"
+                      "ld1       {v4.4s}, [%0]               \n\t"
+                      "eor       v0.16b, v0.16b, v4.16b      \n\t"
+                      "eor       v1.16b, v1.16b, v4.16b      \n\t"
+                      "eor       v2.16b, v2.16b, v4.16b      \n\t"
+                      "eor       v3.16b, v3.16b, v4.16b      \n\t"
+                      "st1       {v0.16b-v3.16b}, [%3]       \n\t" // export output
+                      : "+r" (rk), "+r" (nr)
+                      : "r" (input), "r" (output)
+                      : "memory", "cc" AESCE_CLOBBER( "v0" ) AESCE_CLOBBER( "v1" )
+                        AESCE_CLOBBER( "v2" ) AESCE_CLOBBER( "v3" )
+                        AESCE_CLOBBER( "v4" ) );
+    }
+    AESCE_END();
+
+    for( ; nblocks > 0; nblocks--, input += 16, output += 16 )
+        mbedtls_aesce_crypt_ecb( ctx, MBEDTLS_AES_ENCRYPT, input, output );
+
+    return( 0 );
+}
+
+#endif /* MBEDTLS_HAVE_ARM64 */
+
+#endif /* MBEDTLS_AESCE_C */
@@ -48,11 +48,42 @@
 
 #if defined(MBEDTLS_HAVE_X86_64)
 
+#if defined(__KERNEL__)
+#include <linux/version.h>
+#include <asm/cpufeature.h>
+#if (KERNEL_VERSION(4, 2, 0) > LINUX_VERSION_CODE)
+#include <asm/i387.h>
+#else
+#include <asm/fpu/api.h>
+#endif
+
+/*
+ * The kernel is built without SSE, so the xmm registers must not appear in
+ * clobber lists. kernel_fpu_begin() saves them for us.
+ */
+#define AESNI_BEGIN()           kernel_fpu_begin()
+#define AESNI_END()             kernel_fpu_end()
+#define AESNI_CLOBBER( reg )
+#else
+#define AESNI_BEGIN()
+#define AESNI_END()
+#define AESNI_CLOBBER( reg )    , reg
+#endif
+
 /*
  * AES-NI support detection routine
  */
 int mbedtls_aesni_has_support( unsigned int what )
 {
+#if defined(__KERNEL__)
+    if( ! irq_fpu_usable() )
+        return( 0 );
+    if( what == MBEDTLS_AESNI_AES )
+        return( boot_cpu_has( X86_FEATURE_AES ) );
+    if( what == MBEDTLS_AESNI_CLMUL )
+        return( boot_cpu_has( X86_FEATURE_PCLMULQDQ ) );
+    return( 0 );
+#else
     static int done = 0;
     static unsigned int c = 0;
 
@@ -67,6 +98,7 @@ int mbedtls_aesni_has_support( unsigned int what )
     }
 
     return( ( c & what ) != 0 );
+#endif
 }
 
 /*
@@ -94,6 +126,10 @@ int mbedtls_aesni_has_support( unsigned int what )
 #define xmm0_xmm4   "0xE0"
 #define xmm1_xmm0   "0xC1"
 #define xmm1_xmm2   "0xD1"
+#define xmm4_xmm0   "0xC4"
+#define xmm4_xmm1   "0xCC"
+#define xmm4_xmm2   "0xD4"
+#define xmm4_xmm3   "0xDC"
 
 /*
  * AES-NI AES-ECB block en(de)cryption
@@ -103,6 +139,7 @@ int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
                      const unsigned char input[16],
                      unsigned char output[16] )
 {
+    AESNI_BEGIN();
     asm( "movdqu    (%3), %%xmm0    \n\t" // load input
          "movdqu    (%1), %%xmm1    \n\t" // load round key 0
          "pxor      %%xmm1, %%xmm0  \n\t" // round 0
@@ -134,8 +171,69 @@ int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
          "movdqu    %%xmm0, (%4)    \n\t" // export output
          :
          : "r" (ctx->nr), "r" (ctx->rk), "r" (mode), "r" (input), "r" (output)
-         : "memory", "cc", "xmm0", "xmm1" );
+         : "memory", "cc" AESNI_CLOBBER( "xmm0" ) AESNI_CLOBBER( "xmm1" ) );
+    AESNI_END();
+
+    return( 0 );
+}
+
+/*
+ * AES-NI encryption of several independent blocks. AESENC is pipelined, so
+ * 4 interleaved blocks take about the same time as one.
+ */
+int mbedtls_aesni_encrypt_blocks( mbedtls_aes_context *ctx,
+                     size_t nblocks,
+                     const unsigned char *input,
+                     unsigned char *output )
+{
+    const uint32_t *rk;
+    int nr;
 
+    AESNI_BEGIN();
+    for( ; nblocks >= 4; nblocks -= 4, input += 64, output += 64 )
+    {
+        rk = ctx->rk;
+        nr = ctx->nr - 1;
+        asm volatile( "movdqu    (%2), %%xmm0    \n\t" // load input
+                      "movdqu    16(%2), %%xmm1  \n\t"
+                      "movdqu    32(%2), %%xmm2  \n\t"
+                      "movdqu    48(%2), %%xmm3  \n\t"
+                      "movdqu    (%0), %%xmm4    \n\t" // load round key 0
+                      "pxor      %%xmm4, %%xmm0  \n\t" // round 0
+                      "pxor      %%xmm4, %%xmm1  \n\t"
+                      "pxor      %%xmm4, %%xmm2  \n\t"
+                      "pxor      %%xmm4, %%xmm3  \n\t"
+                      "add       $16, %0         \n\t" // point to next round key
+
+                      "1:                        \n\t" // normal rounds = nr - 1
+                      "movdqu    (%0), %%xmm4    \n\t" // load round key
+                      AESENC     xmm4_xmm0      "\n\t" // do round
+                      AESENC     xmm4_xmm1      "\n\t"
+                      AESENC     xmm4_xmm2      "\n\t"
+                      AESENC     xmm4_xmm3      "\n\t"
+                      "add       $16, %0         \n\t" // point to next round key
+                      "subl      $1, %1          \n\t" // loop
+                      "jnz       1b              \n\t"
+                      "movdqu    (%0), %%xmm4    \n\t" // load round key
+                      AESENCLAST xmm4_xmm0      "\n\t" // last round
+                      AESENCLAST xmm4_xmm1      "\n\t"
+                      AESENCLAST xmm4_xmm2      "\n\t"
+                      AESENCLAST xmm4_xmm3      "\n\t"
+
+                      "movdqu    %%xmm0, (%3)    \n\t" // export output
+                      "movdqu    %%xmm1, 16(%3)  \n\t"
+                      "movdqu    %%xmm2, 32(%3)  \n\t"
+                      "movdqu    %%xmm3, 48(%3)  \n\t"
+                      : "+r" (rk), "+r" (nr)
+                      : "r" (input), "r" (output)
+                      : "memory", "cc" AESNI_CLOBBER( "xmm0" ) AESNI_CLOBBER( "xmm1" )
+                        AESNI_CLOBBER( "xmm2" ) AESNI_CLOBBER( "xmm3" )
+                        AESNI_CLOBBER( "xmm4" ) );
+    }
+    AESNI_END();
+
+    for( ; nblocks > 0; nblocks--, input += 16, output += 16 )
+        mbedtls_aesni_crypt_ecb( ctx, MBEDTLS_AES_ENCRYPT, input, output );
 
     return( 0 );
 }
@@ -158,6 +256,7 @@ void mbedtls_aesni_gcm_mult( unsigned char c[16],
         bb[i] = b[15 - i];
     }
 
+    AESNI_BEGIN();
     asm( "movdqu (%0), %%xmm0               \n\t" // a1:a0
          "movdqu (%1), %%xmm1               \n\t" // b1:b0
 
@@ -243,7 +342,10 @@ void mbedtls_aesni_gcm_mult( unsigned char c[16],
          "movdqu %%xmm0, (%2)               \n\t" // done
          :
          : "r" (aa), "r" (bb), "r" (cc)
-         : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5" );
+         : "memory", "cc" AESNI_CLOBBER( "xmm0" ) AESNI_CLOBBER( "xmm1" )
+           AESNI_CLOBBER( "xmm2" ) AESNI_CLOBBER( "xmm3" )
+           AESNI_CLOBBER( "xmm4" ) AESNI_CLOBBER( "xmm5" ) );
+    AESNI_END();
 
     /* Now byte-reverse the outputs */
     for( i = 0; i < 16; i++ )
@@ -263,17 +365,26 @@ void mbedtls_aesni_inverse_key( unsigned char *invkey,
 
     memcpy( ik, fk, 16 );
 
+    AESNI_BEGIN();
     for( fk -= 16, ik += 16; fk > fwdkey; fk -= 16, ik += 16 )
         asm( "movdqu (%0), %%xmm0       \n\t"
              AESIMC  xmm0_xmm0         "\n\t"
              "movdqu %%xmm0, (%1)       \n\t"
              :
              : "r" (fk), "r" (ik)
-             : "memory", "xmm0" );
+             : "memory" AESNI_CLOBBER( "xmm0" ) );
+    AESNI_END();
 
     memcpy( ik, fk, 16 );
 }
 
+#if !defined(__KERNEL__)
+/*
+ * The key expansion below uses call/ret inside inline assembly, which the
+ * kernel (objtool, return thunks) does not allow. mbedtls_aes_setkey_enc()
+ * computes the same round keys in C.
+ */
+
 /*
  * Key expansion, 128-bit case
  */
@@ -464,6 +575,7 @@ int mbedtls_aesni_setkey_enc( unsigned char *rk,
 
     return( 0 );
 }
+#endif /* !__KERNEL__ */
 
 #endif /* MBEDTLS_HAVE_X86_64 */
 
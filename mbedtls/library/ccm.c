@@ -38,6 +38,12 @@
 
 #include "mbedtls/ccm.h"
 #include "mbedtls/platform_util.h"
+#include "mbedtls/cipher_internal.h"
+
+#if defined(MBEDTLS_AES_C) && !defined(MBEDTLS_AES_ALT)
+#include "mbedtls/aes.h"
+#define CCM_AES_DIRECT
+#endif
 
 #include <string.h>
 
@@ -112,6 +118,50 @@ void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
     mbedtls_platform_zeroize( ctx, sizeof( mbedtls_ccm_context ) );
 }
 
+#if defined(CCM_AES_DIRECT)
+/*
+ * Number of counter blocks encrypted in one call. Hardware AES implementations
+ * process them in parallel.
+ */
+#define CCM_AES_BLOCKS 4
+
+/*
+ * Return the AES context behind the cipher layer, or NULL if the cipher is not
+ * AES. Calling AES directly avoids the dispatch of the cipher layer for each
+ * block.
+ */
+static mbedtls_aes_context *ccm_get_aes( mbedtls_ccm_context *ctx )
+{
+    if( ctx->cipher_ctx.cipher_info == NULL ||
+        ctx->cipher_ctx.cipher_info->base->cipher != MBEDTLS_CIPHER_ID_AES )
+        return( NULL );
+#if defined(MBEDTLS_USE_PSA_CRYPTO)
+    if( ctx->cipher_ctx.psa_enabled == 1 )
+        return( NULL );
+#endif
+
+    return( ctx->cipher_ctx.cipher_ctx );
+}
+#endif /* CCM_AES_DIRECT */
+
+/*
+ * Encrypt one block with the cipher of the context
+ */
+static int ccm_encrypt_block( mbedtls_ccm_context *ctx,
+                              const unsigned char input[16],
+                              unsigned char output[16] )
+{
+    size_t olen;
+#if defined(CCM_AES_DIRECT)
+    mbedtls_aes_context *aes = ccm_get_aes( ctx );
+
+    if( aes != NULL )
+        return( mbedtls_aes_crypt_ecb( aes, MBEDTLS_AES_ENCRYPT, input, output ) );
+#endif
+
+    return( mbedtls_cipher_update( &ctx->cipher_ctx, input, 16, output, &olen ) );
+}
+
 /*
  * Macros for common operations.
  * Results in smaller compiled code than static inline functions.
@@ -125,7 +175,7 @@ void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
     for( i = 0; i < 16; i++ )                                               \
         y[i] ^= b[i];                                                       \
                                                                             \
-    if( ( ret = mbedtls_cipher_update( &ctx->cipher_ctx, y, 16, y, &olen ) ) != 0 ) \
+    if( ( ret = ccm_encrypt_block( ctx, y, y ) ) != 0 )                     \
         return( ret );
 
 /*
@@ -136,8 +186,7 @@ void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
 #define CTR_CRYPT( dst, src, len  )                                            \
     do                                                                  \
     {                                                                   \
-        if( ( ret = mbedtls_cipher_update( &ctx->cipher_ctx, ctr,       \
-                                           16, b, &olen ) ) != 0 )      \
+        if( ( ret = ccm_encrypt_block( ctx, ctr, b ) ) != 0 )           \
         {                                                               \
             return( ret );                                              \
         }                                                               \
@@ -146,6 +195,73 @@ void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
             (dst)[i] = (src)[i] ^ b[i];                                 \
     } while( 0 )
 
+#if defined(CCM_AES_DIRECT)
+/*
+ * Authenticate and {en,de}crypt the message with AES. The counter blocks are
+ * encrypted CCM_AES_BLOCKS at a time, while the CBC-MAC is inherently
+ * sequential. On return, ctr has been incremented once per block.
+ */
+static int ccm_aes_crypt_payload( mbedtls_aes_context *aes, int mode,
+                                  size_t length, unsigned char q,
+                                  const unsigned char *input,
+                                  unsigned char *output,
+                                  unsigned char y[16], unsigned char ctr[16] )
+{
+    int ret = 0;
+    unsigned char ks[16 * CCM_AES_BLOCKS];
+    size_t nblocks, n, i, use_len;
+
+    while( length > 0 )
+    {
+        nblocks = ( length + 15 ) / 16;
+        if( nblocks > CCM_AES_BLOCKS )
+            nblocks = CCM_AES_BLOCKS;
+
+        for( n = 0; n < nblocks; n++ )
+        {
+            memcpy( ks + 16 * n, ctr, 16 );
+            /* No need to check for overflow thanks to the length check */
+            for( i = 0; i < q; i++ )
+                if( ++ctr[15-i] != 0 )
+                    break;
+        }
+
+        ret = mbedtls_internal_aes_encrypt_blocks( aes, nblocks, ks, ks );
+        if( ret != 0 )
+            goto exit;
+
+        for( n = 0; n < nblocks; n++ )
+        {
+            use_len = length > 16 ? 16 : length;
+
+            if( mode == CCM_ENCRYPT )
+                for( i = 0; i < use_len; i++ )
+                    y[i] ^= input[i];
+
+            for( i = 0; i < use_len; i++ )
+                output[i] = input[i] ^ ks[16 * n + i];
+
+            if( mode == CCM_DECRYPT )
+                for( i = 0; i < use_len; i++ )
+                    y[i] ^= output[i];
+
+            ret = mbedtls_aes_crypt_ecb( aes, MBEDTLS_AES_ENCRYPT, y, y );
+            if( ret != 0 )
+                goto exit;
+
+            input += use_len;
+            output += use_len;
+            length -= use_len;
+        }
+    }
+
+exit:
+    mbedtls_platform_zeroize( ks, sizeof( ks ) );
+
+    return( ret );
+}
+#endif /* CCM_AES_DIRECT */
+
 /*
  * Authenticated encryption or decryption
  */
@@ -158,7 +274,7 @@ static int ccm_auth_crypt( mbedtls_ccm_context *ctx, int mode, size_t length,
     int ret;
     unsigned char i;
     unsigned char q;
-    size_t len_left, olen;
+    size_t len_left;
     unsigned char b[16];
     unsigned char y[16];
     unsigned char ctr[16];
@@ -273,6 +389,17 @@ static int ccm_auth_crypt( mbedtls_ccm_context *ctx, int mode, size_t length,
     src = input;
     dst = output;
 
+#if defined(CCM_AES_DIRECT)
+    if( ccm_get_aes( ctx ) != NULL )
+    {
+        ret = ccm_aes_crypt_payload( ccm_get_aes( ctx ), mode, length, q,
+                                     input, output, y, ctr );
+        if( ret != 0 )
+            return( ret );
+        len_left = 0;
+    }
+#endif
+
     while( len_left > 0 )
     {
         size_t use_len = len_left > 16 ? 16 : len_left;
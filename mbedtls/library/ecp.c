@@ -2316,6 +2316,464 @@ cleanup:
     return( ret );
 }
 
+#if defined(MBEDTLS_ECP_X25519_FAST)
+/*
+ * Dedicated implementation of X25519 (RFC 7748) for Curve25519.
+ *
+ * Field elements use fixed-size limbs and all the operations are constant
+ * time and done on the stack. It is far faster than the generic ladder above,
+ * which relies on the MPI layer.
+ *
+ * With a 128-bit type, elements are stored on 5 limbs of 51 bits. Else, they
+ * are stored on 16 signed limbs of 16 bits (the representation used by
+ * TweetNaCl).
+ */
+#if defined(__KERNEL__)
+/*
+ * Without CONFIG_ARCH_SUPPORTS_INT128, the compiler may emit calls to
+ * helpers (__multi3...) that the kernel does not provide.
+ */
+#if defined(CONFIG_ARCH_SUPPORTS_INT128) && defined(__SIZEOF_INT128__)
+#define X25519_HAVE_INT128
+#endif
+#elif defined(__SIZEOF_INT128__)
+#define X25519_HAVE_INT128
+#endif
+
+#if defined(X25519_HAVE_INT128)
+
+typedef uint64_t x25519_fe[5];
+
+#define X25519_MASK51   ( ( (uint64_t) 1 << 51 ) - 1 )
+
+static void x25519_fe_carry( x25519_fe h )
+{
+    h[1] += h[0] >> 51; h[0] &= X25519_MASK51;
+    h[2] += h[1] >> 51; h[1] &= X25519_MASK51;
+    h[3] += h[2] >> 51; h[2] &= X25519_MASK51;
+    h[4] += h[3] >> 51; h[3] &= X25519_MASK51;
+    h[0] += 19 * ( h[4] >> 51 ); h[4] &= X25519_MASK51;
+    h[1] += h[0] >> 51; h[0] &= X25519_MASK51;
+}
+
+static void x25519_fe_frombytes( x25519_fe h, const unsigned char s[32] )
+{
+    uint64_t w[4];
+    size_t i;
+
+    for( i = 0; i < 4; i++ )
+        w[i] = (uint64_t) s[8 * i + 0]       | (uint64_t) s[8 * i + 1] << 8  |
+               (uint64_t) s[8 * i + 2] << 16 | (uint64_t) s[8 * i + 3] << 24 |
+               (uint64_t) s[8 * i + 4] << 32 | (uint64_t) s[8 * i + 5] << 40 |
+               (uint64_t) s[8 * i + 6] << 48 | (uint64_t) s[8 * i + 7] << 56;
+
+    h[0] = w[0] & X25519_MASK51;
+    h[1] = ( ( w[0] >> 51 ) | ( w[1] << 13 ) ) & X25519_MASK51;
+    h[2] = ( ( w[1] >> 38 ) | ( w[2] << 26 ) ) & X25519_MASK51;
+    h[3] = ( ( w[2] >> 25 ) | ( w[3] << 39 ) ) & X25519_MASK51;
+    h[4] = ( w[3] >> 12 ) & X25519_MASK51;
+}
+
+/* Fully reduce modulo p = 2^255 - 19 and serialize in little endian */
+static void x25519_fe_tobytes( unsigned char s[32], const x25519_fe f )
+{
+    uint64_t t[5], w[4];
+    size_t i;
+
+    memcpy( t, f, sizeof( t ) );
+    x25519_fe_carry( t );
+    x25519_fe_carry( t );
+    /* Now t < 2^255 + small. Compute t + 19 to know if t >= p */
+    t[0] += 19;
+    x25519_fe_carry( t );
+    /* Add 2^255 - 19 and drop 2^255, so the result is t - p if t >= p or t
+     * otherwise (offset by 19 was already added). */
+    t[0] += ( (uint64_t) 1 << 51 ) - 19;
+    t[1] += ( (uint64_t) 1 << 51 ) - 1;
+    t[2] += ( (uint64_t) 1 << 51 ) - 1;
+    t[3] += ( (uint64_t) 1 << 51 ) - 1;
+    t[4] += ( (uint64_t) 1 << 51 ) - 1;
+    t[1] += t[0] >> 51; t[0] &= X25519_MASK51;
+    t[2] += t[1] >> 51; t[1] &= X25519_MASK51;
+    t[3] += t[2] >> 51; t[2] &= X25519_MASK51;
+    t[4] += t[3] >> 51; t[3] &= X25519_MASK51;
+    t[4] &= X25519_MASK51;
+
+    w[0] = t[0]         | t[1] << 51;
+    w[1] = t[1] >> 13   | t[2] << 38;
+    w[2] = t[2] >> 26   | t[3] << 25;
+    w[3] = t[3] >> 39   | t[4] << 12;
+    for( i = 0; i < 32; i++ )
+        s[i] = (unsigned char)( w[i / 8] >> ( 8 * ( i % 8 ) ) );
+    mbedtls_platform_zeroize( t, sizeof( t ) );
+    mbedtls_platform_zeroize( w, sizeof( w ) );
+}
+
+static void x25519_fe_set( x25519_fe h, uint64_t v )
+{
+    h[0] = v; h[1] = 0; h[2] = 0; h[3] = 0; h[4] = 0;
+}
+
+static void x25519_fe_add( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    size_t i;
+
+    for( i = 0; i < 5; i++ )
+        h[i] = f[i] + g[i];
+    x25519_fe_carry( h );
+}
+
+/* Add 4p before subtracting so the limbs never become negative */
+static void x25519_fe_sub( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    h[0] = f[0] + 0x1FFFFFFFFFFFB4 - g[0];
+    h[1] = f[1] + 0x1FFFFFFFFFFFFC - g[1];
+    h[2] = f[2] + 0x1FFFFFFFFFFFFC - g[2];
+    h[3] = f[3] + 0x1FFFFFFFFFFFFC - g[3];
+    h[4] = f[4] + 0x1FFFFFFFFFFFFC - g[4];
+    x25519_fe_carry( h );
+}
+
+static void x25519_fe_mul( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    unsigned __int128 r0, r1, r2, r3, r4;
+    uint64_t g1_19 = 19 * g[1], g2_19 = 19 * g[2];
+    uint64_t g3_19 = 19 * g[3], g4_19 = 19 * g[4];
+    uint64_t c;
+
+    r0 = (unsigned __int128) f[0] * g[0] + (unsigned __int128) f[1] * g4_19 +
+         (unsigned __int128) f[2] * g3_19 + (unsigned __int128) f[3] * g2_19 +
+         (unsigned __int128) f[4] * g1_19;
+    r1 = (unsigned __int128) f[0] * g[1] + (unsigned __int128) f[1] * g[0] +
+         (unsigned __int128) f[2] * g4_19 + (unsigned __int128) f[3] * g3_19 +
+         (unsigned __int128) f[4] * g2_19;
+    r2 = (unsigned __int128) f[0] * g[2] + (unsigned __int128) f[1] * g[1] +
+         (unsigned __int128) f[2] * g[0] + (unsigned __int128) f[3] * g4_19 +
+         (unsigned __int128) f[4] * g3_19;
+    r3 = (unsigned __int128) f[0] * g[3] + (unsigned __int128) f[1] * g[2] +
+         (unsigned __int128) f[2] * g[1] + (unsigned __int128) f[3] * g[0] +
+         (unsigned __int128) f[4] * g4_19;
+    r4 = (unsigned __int128) f[0] * g[4] + (unsigned __int128) f[1] * g[3] +
+         (unsigned __int128) f[2] * g[2] + (unsigned __int128) f[3] * g[1] +
+         (unsigned __int128) f[4] * g[0];
+
+    r1 += (uint64_t)( r0 >> 51 ); h[0] = (uint64_t) r0 & X25519_MASK51;
+    r2 += (uint64_t)( r1 >> 51 ); h[1] = (uint64_t) r1 & X25519_MASK51;
+    r3 += (uint64_t)( r2 >> 51 ); h[2] = (uint64_t) r2 & X25519_MASK51;
+    r4 += (uint64_t)( r3 >> 51 ); h[3] = (uint64_t) r3 & X25519_MASK51;
+    c = (uint64_t)( r4 >> 51 );   h[4] = (uint64_t) r4 & X25519_MASK51;
+    /* c < 2^62, so 19 * c needs 128 bits */
+    r0 = (unsigned __int128) c * 19 + h[0];
+    h[0] = (uint64_t) r0 & X25519_MASK51;
+    h[1] += (uint64_t)( r0 >> 51 );
+}
+
+static void x25519_fe_cswap( x25519_fe f, x25519_fe g, unsigned int b )
+{
+    uint64_t mask = (uint64_t) 0 - b, x;
+    size_t i;
+
+    for( i = 0; i < 5; i++ )
+    {
+        x = mask & ( f[i] ^ g[i] );
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+#else /* X25519_HAVE_INT128 */
+
+typedef int64_t x25519_fe[16];
+
+static void x25519_fe_carry( x25519_fe h )
+{
+    int64_t c;
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        h[i] += (int64_t) 1 << 16;
+        c = h[i] >> 16;
+        if( i < 15 )
+            h[i + 1] += c - 1;
+        else
+            h[0] += 38 * ( c - 1 );
+        h[i] -= c << 16;
+    }
+}
+
+static void x25519_fe_frombytes( x25519_fe h, const unsigned char s[32] )
+{
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+        h[i] = s[2 * i] + ( (int64_t) s[2 * i + 1] << 8 );
+    h[15] &= 0x7FFF;
+}
+
+static void x25519_fe_cswap( x25519_fe f, x25519_fe g, unsigned int b )
+{
+    int64_t mask = (int64_t) 0 - b, x;
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        x = mask & ( f[i] ^ g[i] );
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+/* Fully reduce modulo p = 2^255 - 19 and serialize in little endian */
+static void x25519_fe_tobytes( unsigned char s[32], const x25519_fe f )
+{
+    x25519_fe t, m;
+    unsigned int b;
+    size_t i, j;
+
+    memcpy( t, f, sizeof( t ) );
+    x25519_fe_carry( t );
+    x25519_fe_carry( t );
+    x25519_fe_carry( t );
+    for( j = 0; j < 2; j++ )
+    {
+        m[0] = t[0] - 0xFFED;
+        for( i = 1; i < 15; i++ )
+        {
+            m[i] = t[i] - 0xFFFF - ( ( m[i - 1] >> 16 ) & 1 );
+            m[i - 1] &= 0xFFFF;
+        }
+        m[15] = t[15] - 0x7FFF - ( ( m[14] >> 16 ) & 1 );
+        b = (unsigned int)( ( m[15] >> 16 ) & 1 );
+        m[14] &= 0xFFFF;
+        x25519_fe_cswap( t, m, 1 - b );
+    }
+    for( i = 0; i < 16; i++ )
+    {
+        s[2 * i] = (unsigned char)( t[i] & 0xFF );
+        s[2 * i + 1] = (unsigned char)( t[i] >> 8 );
+    }
+    mbedtls_platform_zeroize( t, sizeof( t ) );
+    mbedtls_platform_zeroize( m, sizeof( m ) );
+}
+
+static void x25519_fe_set( x25519_fe h, int64_t v )
+{
+    memset( h, 0, sizeof( x25519_fe ) );
+    h[0] = v;
+}
+
+static void x25519_fe_add( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+        h[i] = f[i] + g[i];
+}
+
+static void x25519_fe_sub( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+        h[i] = f[i] - g[i];
+}
+
+static void x25519_fe_mul( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    int64_t t[31];
+    size_t i, j;
+
+    memset( t, 0, sizeof( t ) );
+    for( i = 0; i < 16; i++ )
+        for( j = 0; j < 16; j++ )
+            t[i + j] += f[i] * g[j];
+    /* 2^256 = 38 mod p */
+    for( i = 0; i < 15; i++ )
+        t[i] += 38 * t[i + 16];
+    memcpy( h, t, sizeof( x25519_fe ) );
+    x25519_fe_carry( h );
+    x25519_fe_carry( h );
+}
+
+#endif /* X25519_HAVE_INT128 */
+
+static void x25519_fe_sqn( x25519_fe h, const x25519_fe f, int n )
+{
+    x25519_fe_mul( h, f, f );
+    while( --n > 0 )
+        x25519_fe_mul( h, h, h );
+}
+
+/* h = f^(p - 2) = 1 / f, with a fixed chain of squarings and multiplications */
+static void x25519_fe_invert( x25519_fe h, const x25519_fe f )
+{
+    x25519_fe z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+    x25519_fe_sqn( z2, f, 1 );
+    x25519_fe_sqn( t, z2, 2 );
+    x25519_fe_mul( z9, t, f );
+    x25519_fe_mul( z11, z9, z2 );
+    x25519_fe_sqn( t, z11, 1 );
+    x25519_fe_mul( z2_5_0, t, z9 );
+    x25519_fe_sqn( t, z2_5_0, 5 );
+    x25519_fe_mul( z2_10_0, t, z2_5_0 );
+    x25519_fe_sqn( t, z2_10_0, 10 );
+    x25519_fe_mul( z2_20_0, t, z2_10_0 );
+    x25519_fe_sqn( t, z2_20_0, 20 );
+    x25519_fe_mul( t, t, z2_20_0 );
+    x25519_fe_sqn( t, t, 10 );
+    x25519_fe_mul( z2_50_0, t, z2_10_0 );
+    x25519_fe_sqn( t, z2_50_0, 50 );
+    x25519_fe_mul( z2_100_0, t, z2_50_0 );
+    x25519_fe_sqn( t, z2_100_0, 100 );
+    x25519_fe_mul( t, t, z2_100_0 );
+    x25519_fe_sqn( t, t, 50 );
+    x25519_fe_mul( t, t, z2_50_0 );
+    x25519_fe_sqn( t, t, 5 );
+    x25519_fe_mul( h, t, z11 );
+
+    mbedtls_platform_zeroize( z2, sizeof( z2 ) );
+    mbedtls_platform_zeroize( z9, sizeof( z9 ) );
+    mbedtls_platform_zeroize( z11, sizeof( z11 ) );
+    mbedtls_platform_zeroize( z2_5_0, sizeof( z2_5_0 ) );
+    mbedtls_platform_zeroize( z2_10_0, sizeof( z2_10_0 ) );
+    mbedtls_platform_zeroize( z2_20_0, sizeof( z2_20_0 ) );
+    mbedtls_platform_zeroize( z2_50_0, sizeof( z2_50_0 ) );
+    mbedtls_platform_zeroize( z2_100_0, sizeof( z2_100_0 ) );
+    mbedtls_platform_zeroize( t, sizeof( t ) );
+}
+
+/*
+ * Montgomery ladder of RFC 7748 section 5. k and u are little endian. The
+ * scalar is expected to be already clamped (this is checked by
+ * mbedtls_ecp_check_privkey()) and u to be lower than 2^255.
+ *
+ * Return 0 if the result is the point at infinity.
+ */
+static int x25519_ladder( unsigned char out[32], const unsigned char k[32],
+                          const unsigned char u[32] )
+{
+    x25519_fe x1, x2, z2, x3, z3, a, aa, b, bb, e, c, d, da, cb, a24;
+    unsigned char zb[32], nonzero = 0;
+    unsigned int swap = 0, bit;
+    int t;
+    size_t i;
+
+    x25519_fe_frombytes( x1, u );
+    x25519_fe_set( x2, 1 );
+    x25519_fe_set( z2, 0 );
+    memcpy( x3, x1, sizeof( x3 ) );
+    x25519_fe_set( z3, 1 );
+    x25519_fe_set( a24, 121665 );
+
+    for( t = 254; t >= 0; t-- )
+    {
+        bit = ( k[t >> 3] >> ( t & 7 ) ) & 1;
+        swap ^= bit;
+        x25519_fe_cswap( x2, x3, swap );
+        x25519_fe_cswap( z2, z3, swap );
+        swap = bit;
+
+        x25519_fe_add( a, x2, z2 );
+        x25519_fe_mul( aa, a, a );
+        x25519_fe_sub( b, x2, z2 );
+        x25519_fe_mul( bb, b, b );
+        x25519_fe_sub( e, aa, bb );
+        x25519_fe_add( c, x3, z3 );
+        x25519_fe_sub( d, x3, z3 );
+        x25519_fe_mul( da, d, a );
+        x25519_fe_mul( cb, c, b );
+        x25519_fe_add( x3, da, cb );
+        x25519_fe_mul( x3, x3, x3 );
+        x25519_fe_sub( z3, da, cb );
+        x25519_fe_mul( z3, z3, z3 );
+        x25519_fe_mul( z3, z3, x1 );
+        x25519_fe_mul( x2, aa, bb );
+        x25519_fe_mul( z2, a24, e );
+        x25519_fe_add( z2, z2, aa );
+        x25519_fe_mul( z2, z2, e );
+    }
+    x25519_fe_cswap( x2, x3, swap );
+    x25519_fe_cswap( z2, z3, swap );
+
+    x25519_fe_tobytes( zb, z2 );
+    for( i = 0; i < sizeof( zb ); i++ )
+        nonzero |= zb[i];
+
+    x25519_fe_invert( z2, z2 );
+    x25519_fe_mul( x2, x2, z2 );
+    x25519_fe_tobytes( out, x2 );
+
+    mbedtls_platform_zeroize( x1, sizeof( x1 ) );
+    mbedtls_platform_zeroize( x2, sizeof( x2 ) );
+    mbedtls_platform_zeroize( z2, sizeof( z2 ) );
+    mbedtls_platform_zeroize( x3, sizeof( x3 ) );
+    mbedtls_platform_zeroize( z3, sizeof( z3 ) );
+    mbedtls_platform_zeroize( a, sizeof( a ) );
+    mbedtls_platform_zeroize( aa, sizeof( aa ) );
+    mbedtls_platform_zeroize( b, sizeof( b ) );
+    mbedtls_platform_zeroize( bb, sizeof( bb ) );
+    mbedtls_platform_zeroize( e, sizeof( e ) );
+    mbedtls_platform_zeroize( c, sizeof( c ) );
+    mbedtls_platform_zeroize( d, sizeof( d ) );
+    mbedtls_platform_zeroize( da, sizeof( da ) );
+    mbedtls_platform_zeroize( cb, sizeof( cb ) );
+    mbedtls_platform_zeroize( zb, sizeof( zb ) );
+
+    return( nonzero != 0 );
+}
+
+static void x25519_reverse( unsigned char *buf, size_t len )
+{
+    unsigned char tmp;
+    size_t i;
+
+    for( i = 0; i < len / 2; i++ )
+    {
+        tmp = buf[i];
+        buf[i] = buf[len - 1 - i];
+        buf[len - 1 - i] = tmp;
+    }
+}
+
+/*
+ * Same result as ecp_mul_mxz() for Curve25519 when P->X < 2^255. The
+ * randomization of the coordinates is not necessary since the computation is
+ * constant time.
+ */
+static int ecp_mul_x25519( mbedtls_ecp_point *R, const mbedtls_mpi *m,
+                           const mbedtls_ecp_point *P )
+{
+    int ret;
+    unsigned char k[32], u[32], out[32];
+
+    /* Read P before writing to R, in case P == R */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( m, k, sizeof( k ) ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( &P->X, u, sizeof( u ) ) );
+    x25519_reverse( k, sizeof( k ) );
+    x25519_reverse( u, sizeof( u ) );
+
+    /* Like ecp_normalize_mxz(), fail to invert Z for the point at infinity */
+    if( x25519_ladder( out, k, u ) == 0 )
+    {
+        ret = MBEDTLS_ERR_MPI_NOT_ACCEPTABLE;
+        goto cleanup;
+    }
+
+    x25519_reverse( out, sizeof( out ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_read_binary( &R->X, out, sizeof( out ) ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &R->Z, 1 ) );
+    mbedtls_mpi_free( &R->Y );
+
+cleanup:
+    mbedtls_platform_zeroize( k, sizeof( k ) );
+    mbedtls_platform_zeroize( out, sizeof( out ) );
+
+    return( ret );
+}
+#endif /* MBEDTLS_ECP_X25519_FAST */
+
 #endif /* ECP_MONTGOMERY */
 
 /*
@@ -2362,7 +2820,15 @@ int mbedtls_ecp_mul_restartable( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
     ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
 #if defined(ECP_MONTGOMERY)
     if( ecp_get_type( grp ) == ECP_TYPE_MONTGOMERY )
+    {
+#if defined(MBEDTLS_ECP_X25519_FAST)
+        if( grp->id == MBEDTLS_ECP_DP_CURVE25519 &&
+            mbedtls_mpi_bitlen( &P->X ) <= 255 )
+            MBEDTLS_MPI_CHK( ecp_mul_x25519( R, m, P ) );
+        else
+#endif
         MBEDTLS_MPI_CHK( ecp_mul_mxz( grp, R, m, P, f_rng, p_rng ) );
+    }
 #endif
 #if defined(ECP_SHORTWEIERSTRASS)
     if( ecp_get_type( grp ) == ECP_TYPE_SHORT_WEIERSTRASS )
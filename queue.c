@@ -21,6 +21,11 @@ static inline s64 ktime_ms_delta(const ktime_t later, const ktime_t earlier)
 }
 #endif
 
+/* The device is in charge to respect the details of the QoS parameters. The driver just ensure that
+ * it roughtly respect the priorities to avoid any shortage.
+ */
+static const int wfx_tx_queue_priorities[IEEE80211_NUM_ACS] = { 1, 2, 64, 128 };
+
 void wfx_tx_lock(struct wfx_dev *wdev)
 {
 	atomic_inc(&wdev->tx_lock);
@@ -40,7 +45,7 @@ void wfx_tx_flush(struct wfx_dev *wdev)
 	int ret;
 
 	/* Do not wait for any reply if chip is frozen */
-	if (wdev->chip_frozen)
+	if (READ_ONCE(wdev->chip_frozen))
 		return;
 
 	wfx_tx_lock(wdev);
@@ -51,8 +56,8 @@ void wfx_tx_flush(struct wfx_dev *wdev)
 		dev_warn(wdev->dev, "cannot flush tx buffers (%d still busy)\n",
 			 wdev->hif.tx_buffers_used);
 		wfx_pending_dump_old_frames(wdev, 3000);
-		/* FIXME: drop pending frames here */
-		wdev->chip_frozen = true;
+		/* Pending frames are dropped by the recovery of the chip */
+		wfx_chip_set_frozen(wdev);
 	}
 	mutex_unlock(&wdev->hif_cmd.lock);
 	wfx_tx_unlock(wdev);
@@ -66,17 +71,16 @@ void wfx_tx_lock_flush(struct wfx_dev *wdev)
 
 void wfx_tx_queues_init(struct wfx_vif *wvif)
 {
-	/* The device is in charge to respect the details of the QoS parameters. The driver just
-	 * ensure that it roughtly respect the priorities to avoid any shortage.
-	 */
-	const int priorities[IEEE80211_NUM_ACS] = { 1, 2, 64, 128 };
 	int i;
 
 	for (i = 0; i < IEEE80211_NUM_ACS; ++i) {
 		skb_queue_head_init(&wvif->tx_queue[i].normal);
 		skb_queue_head_init(&wvif->tx_queue[i].cab);
 		skb_queue_head_init(&wvif->tx_queue[i].offchan);
-		wvif->tx_queue[i].priority = priorities[i];
+		wvif->tx_queue[i].priority = wfx_tx_queue_priorities[i];
+		wvif->tx_queue[i].last_put = jiffies - HZ;
+		spin_lock_init(&wvif->tx_queue[i].latency_lock);
+		memset(&wvif->tx_queue[i].latency, 0, sizeof(wvif->tx_queue[i].latency));
 	}
 }
 
@@ -124,6 +128,7 @@ void wfx_tx_queues_put(struct wfx_vif *wvif, struct sk_buff *skb)
 	struct wfx_queue *queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
 	struct ieee80211_tx_info *tx_info = IEEE80211_SKB_CB(skb);
 
+	queue->last_put = jiffies;
 	if (tx_info->flags & IEEE80211_TX_CTL_TX_OFFCHAN)
 		skb_queue_tail(&queue->offchan, skb);
 	else if (tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM)
@@ -138,7 +143,8 @@ void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
 	struct wfx_vif *wvif;
 	struct sk_buff *skb;
 
-	WARN(!wdev->chip_frozen, "%s should only be used to recover a frozen device", __func__);
+	WARN(!READ_ONCE(wdev->chip_frozen), "%s should only be used to recover a frozen device",
+	     __func__);
 	while ((skb = skb_dequeue(&wdev->tx_pending)) != NULL) {
 		wvif = wfx_skb_wvif(wdev, skb);
 		if (wvif) {
@@ -151,34 +157,39 @@ void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
 	}
 }
 
+/* Caller must hold pending->lock */
+static struct sk_buff *wfx_pending_find(struct sk_buff_head *pending, u32 packet_id)
+{
+	struct sk_buff *skb;
+
+	skb_queue_walk(pending, skb)
+		if (wfx_skb_txreq(skb)->packet_id == packet_id)
+			return skb;
+	return NULL;
+}
+
 struct sk_buff *wfx_pending_get(struct wfx_dev *wdev, u32 packet_id)
 {
 	struct wfx_queue *queue;
-	struct wfx_hif_req_tx *req;
 	struct wfx_vif *wvif;
-	struct wfx_hif_msg *hif;
 	struct sk_buff *skb;
 
 	spin_lock_bh(&wdev->tx_pending.lock);
-	skb_queue_walk(&wdev->tx_pending, skb) {
-		hif = (struct wfx_hif_msg *)skb->data;
-		req = (struct wfx_hif_req_tx *)hif->body;
-		if (req->packet_id != packet_id)
-			continue;
-		spin_unlock_bh(&wdev->tx_pending.lock);
-		wvif = wfx_skb_wvif(wdev, skb);
-		if (wvif) {
-			queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
-			WARN_ON(skb_get_queue_mapping(skb) > 3);
-			WARN_ON(!atomic_read(&queue->pending_frames));
-			atomic_dec(&queue->pending_frames);
-		}
-		skb_unlink(skb, &wdev->tx_pending);
-		return skb;
-	}
+	skb = wfx_pending_find(&wdev->tx_pending, packet_id);
 	spin_unlock_bh(&wdev->tx_pending.lock);
-	WARN(1, "cannot find packet in pending queue");
-	return NULL;
+	if (!skb) {
+		WARN(1, "cannot find packet in pending queue");
+		return NULL;
+	}
+	wvif = wfx_skb_wvif(wdev, skb);
+	if (wvif) {
+		queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
+		WARN_ON(skb_get_queue_mapping(skb) > 3);
+		WARN_ON(!atomic_read(&queue->pending_frames));
+		atomic_dec(&queue->pending_frames);
+	}
+	skb_unlink(skb, &wdev->tx_pending);
+	return skb;
 }
 
 void wfx_pending_dump_old_frames(struct wfx_dev *wdev, unsigned int limit_ms)
@@ -235,10 +246,22 @@ static int wfx_tx_queue_get_weight(struct wfx_queue *queue)
 	return atomic_read(&queue->pending_frames) * queue->priority;
 }
 
+/* Insert queue in the num_queues first entries of queues[] (already sorted by weight) */
+static void wfx_tx_queues_insert(struct wfx_queue **queues, int num_queues,
+				 struct wfx_queue *queue)
+{
+	int i;
+
+	queues[num_queues] = queue;
+	for (i = num_queues; i > 0; i--)
+		if (wfx_tx_queue_get_weight(queues[i]) < wfx_tx_queue_get_weight(queues[i - 1]))
+			swap(queues[i - 1], queues[i]);
+}
+
 static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
 {
 	struct wfx_queue *queues[IEEE80211_NUM_ACS * ARRAY_SIZE(wdev->vif)];
-	int i, j, num_queues = 0;
+	int i, num_queues = 0;
 	struct wfx_vif *wvif;
 	struct wfx_hif_msg *hif;
 	struct sk_buff *skb;
@@ -248,11 +271,7 @@ static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
 	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
 		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
 			WARN_ON(num_queues >= ARRAY_SIZE(queues));
-			queues[num_queues] = &wvif->tx_queue[i];
-			for (j = num_queues; j > 0; j--)
-				if (wfx_tx_queue_get_weight(queues[j]) <
-				    wfx_tx_queue_get_weight(queues[j - 1]))
-					swap(queues[j - 1], queues[j]);
+			wfx_tx_queues_insert(queues, num_queues, &wvif->tx_queue[i]);
 			num_queues++;
 		}
 	}
@@ -274,7 +293,8 @@ static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
 		}
 	}
 
-	if (mutex_is_locked(&wdev->scan_lock))
+	/* A background scan lets the traffic flow between its slices */
+	if (mutex_is_locked(&wdev->scan_lock) && !READ_ONCE(wdev->scan_paused))
 		return NULL;
 
 	wvif = NULL;
@@ -297,7 +317,7 @@ static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
 		}
 		/* No more multicast to sent */
 		wvif->after_dtim_tx_allowed = false;
-		schedule_work(&wvif->update_tim_work);
+		wfx_update_tim_request(wvif);
 	}
 
 	for (i = 0; i < num_queues; i++) {
@@ -327,3 +347,7 @@ struct wfx_hif_msg *wfx_tx_queues_get(struct wfx_dev *wdev)
 	tx_priv->xmit_timestamp = ktime_get();
 	return (struct wfx_hif_msg *)skb->data;
 }
+
+#ifdef CONFIG_WFX_KUNIT_TEST
+#include "queue_test.c"
+#endif
@@ -11,15 +11,28 @@
 #include <linux/skbuff.h>
 #include <linux/atomic.h>
 
+#include "debug.h"
+
 struct wfx_dev;
 struct wfx_vif;
 
+/* Latencies of the frames of a queue, in us */
+struct wfx_tx_latency {
+	struct wfx_hist host;  /* from wfx_tx() to the sending to the device */
+	struct wfx_hist fw;    /* from the sending to the device to the confirmation */
+	struct wfx_hist media; /* media delay reported by the firmware */
+	struct wfx_hist total; /* from wfx_tx() to the confirmation */
+};
+
 struct wfx_queue {
 	struct sk_buff_head normal;
 	struct sk_buff_head cab; /* Content After (DTIM) Beacon */
 	struct sk_buff_head offchan;
 	atomic_t            pending_frames;
 	int                 priority;
+	unsigned long       last_put; /* in jiffies */
+	spinlock_t          latency_lock; /* Protects latency */
+	struct wfx_tx_latency latency;
 };
 
 void wfx_tx_lock(struct wfx_dev *wdev);
@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests of the queues between the tx operation and the bh workqueue.
+ *
+ * Copyright (c) 2017-2020, Silicon Laboratories, Inc.
+ */
+#include <kunit/test.h>
+
+/* This file is included by queue.c, so the tests can reach its static functions */
+
+#define WFX_TEST_LOOPS 10000
+
+/* Frames queued by wfx_test_queues_put(). The kind is stored in the packet_id. The enum is ordered
+ * by priority.
+ */
+enum wfx_test_frame_kind {
+	WFX_TEST_NORMAL,
+	WFX_TEST_CAB,
+	WFX_TEST_OFFCHAN,
+};
+
+struct wfx_queue_test {
+	struct wfx_dev *wdev;
+	struct ieee80211_vif *vifs[2];
+};
+
+static void wfx_test_update_tim_work(struct work_struct *work)
+{
+	/* There is no firmware to update */
+}
+
+/* The device and the vifs are initialized as wfx_init_common() and wfx_add_interface() do for the
+ * fields used by the data path. The device is neither registered nor bound to a bus.
+ */
+static int wfx_queue_test_init(struct kunit *test)
+{
+	struct wfx_queue_test *ctx;
+	struct wfx_vif *wvif;
+	struct wfx_dev *wdev;
+	int i;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+	test->priv = ctx;
+	wdev = kunit_kzalloc(test, sizeof(*wdev), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, wdev);
+	mutex_init(&wdev->conf_mutex);
+	mutex_init(&wdev->scan_lock);
+	skb_queue_head_init(&wdev->tx_pending);
+	init_waitqueue_head(&wdev->tx_dequeue);
+	ctx->wdev = wdev;
+	for (i = 0; i < ARRAY_SIZE(ctx->vifs); i++) {
+		ctx->vifs[i] = kunit_kzalloc(test, sizeof(*ctx->vifs[i]) + sizeof(*wvif),
+					     GFP_KERNEL);
+		KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->vifs[i]);
+		ctx->vifs[i]->type = i ? NL80211_IFTYPE_STATION : NL80211_IFTYPE_AP;
+		ctx->vifs[i]->bss_conf.beacon_int = 100;
+		wvif = (struct wfx_vif *)ctx->vifs[i]->drv_priv;
+		wvif->wdev = wdev;
+		wvif->id = i;
+		INIT_DELAYED_WORK(&wvif->update_tim_work, wfx_test_update_tim_work);
+		mutex_init(&wvif->tim_lock);
+		wvif->tim_last_update = jiffies - HZ;
+		wfx_tx_queues_init(wvif);
+		wdev->vif[i] = ctx->vifs[i];
+	}
+	return 0;
+}
+
+static void wfx_queue_test_exit(struct kunit *test)
+{
+	struct wfx_queue_test *ctx = test->priv;
+	struct wfx_vif *wvif = NULL;
+	int i;
+
+	if (!ctx || !ctx->wdev)
+		return;
+	while ((wvif = wvif_iterate(ctx->wdev, wvif)) != NULL) {
+		cancel_delayed_work_sync(&wvif->update_tim_work);
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			skb_queue_purge(&wvif->tx_queue[i].normal);
+			skb_queue_purge(&wvif->tx_queue[i].cab);
+			skb_queue_purge(&wvif->tx_queue[i].offchan);
+		}
+	}
+	skb_queue_purge(&ctx->wdev->tx_pending);
+}
+
+static struct sk_buff *wfx_test_alloc_frame(struct kunit *test, struct wfx_vif *wvif, int ac,
+					    u32 packet_id)
+{
+	struct wfx_hif_req_tx *req;
+	struct wfx_hif_msg *hif;
+	struct sk_buff *skb;
+
+	skb = alloc_skb(sizeof(*hif) + sizeof(*req), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, skb);
+	hif = skb_put_zero(skb, sizeof(*hif) + sizeof(*req));
+	hif->interface = wvif->id;
+	req = (struct wfx_hif_req_tx *)hif->body;
+	req->packet_id = packet_id;
+	wfx_skb_tx_priv(skb)->vif_id = wvif->id;
+	skb_set_queue_mapping(skb, ac);
+	return skb;
+}
+
+static void wfx_test_queues_put(struct kunit *test, struct wfx_vif *wvif, int ac,
+				enum wfx_test_frame_kind kind)
+{
+	struct sk_buff *skb = wfx_test_alloc_frame(test, wvif, ac, kind);
+
+	if (kind == WFX_TEST_OFFCHAN) {
+		((struct wfx_hif_msg *)skb->data)->interface = 2;
+		IEEE80211_SKB_CB(skb)->flags |= IEEE80211_TX_CTL_TX_OFFCHAN;
+	}
+	if (kind == WFX_TEST_CAB)
+		IEEE80211_SKB_CB(skb)->flags |= IEEE80211_TX_CTL_SEND_AFTER_DTIM;
+	wfx_tx_queues_put(wvif, skb);
+}
+
+/* Every AC of every vif receives normal frames, the AP receives multicast frames to send after the
+ * DTIM and the station receives off-channel frames (as during a scan). Returns the number of
+ * frames queued.
+ */
+static int wfx_test_queues_fill(struct kunit *test, struct wfx_dev *wdev)
+{
+	struct wfx_vif *wvif = NULL;
+	int i, j, num_frames = 0;
+
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			atomic_set(&wvif->tx_queue[i].pending_frames, (wvif->id * 5 + i * 3) % 8);
+			for (j = 0; j < 4; j++, num_frames++)
+				wfx_test_queues_put(test, wvif, i, WFX_TEST_NORMAL);
+			if (wvif_to_vif(wvif)->type == NL80211_IFTYPE_AP) {
+				wfx_test_queues_put(test, wvif, i, WFX_TEST_CAB);
+				num_frames++;
+			} else if (i % 2) {
+				wfx_test_queues_put(test, wvif, i, WFX_TEST_OFFCHAN);
+				num_frames++;
+			}
+		}
+		if (wvif_to_vif(wvif)->type == NL80211_IFTYPE_AP)
+			wvif->after_dtim_tx_allowed = true;
+	}
+	return num_frames;
+}
+
+/* The weights of the queues change between two rankings as the traffic does */
+static void wfx_test_queues_rank(struct kunit *test)
+{
+	struct wfx_queue queues[IEEE80211_NUM_ACS * 2] = { };
+	struct wfx_queue *sorted[ARRAY_SIZE(queues)];
+	int i, j, errors = 0;
+	ktime_t start;
+	s64 delta = 0;
+
+	for (i = 0; i < ARRAY_SIZE(queues); i++)
+		queues[i].priority = wfx_tx_queue_priorities[i % IEEE80211_NUM_ACS];
+	for (i = 0; i < WFX_TEST_LOOPS; i++) {
+		atomic_set(&queues[i % ARRAY_SIZE(queues)].pending_frames, (i * 7) % 32);
+		start = ktime_get();
+		for (j = 0; j < ARRAY_SIZE(queues); j++)
+			wfx_tx_queues_insert(sorted, j, &queues[j]);
+		delta += ktime_to_ns(ktime_sub(ktime_get(), start));
+		for (j = 1; j < ARRAY_SIZE(queues); j++)
+			if (wfx_tx_queue_get_weight(sorted[j]) <
+			    wfx_tx_queue_get_weight(sorted[j - 1]))
+				errors++;
+	}
+	KUNIT_EXPECT_EQ_MSG(test, errors, 0, "queues not sorted by weight");
+	kunit_info(test, "ranking of %zu queues: %lld ns/op\n", ARRAY_SIZE(queues),
+		   div_s64(delta, WFX_TEST_LOOPS));
+}
+
+/* Off-channel frames come first, then the multicast frames, then the normal frames. A scan that is
+ * not paused only lets the off-channel frames go. Returns the number of frames sent.
+ */
+static int wfx_test_queues_drain(struct wfx_dev *wdev, bool scan, int *errors, s64 *delta)
+{
+	enum wfx_test_frame_kind kind, prev = WFX_TEST_OFFCHAN;
+	struct sk_buff *skb;
+	int num_sent = 0;
+	ktime_t start;
+
+	for (;;) {
+		start = ktime_get();
+		skb = wfx_tx_queues_get_skb(wdev);
+		*delta += ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (!skb)
+			return num_sent;
+		kind = wfx_skb_txreq(skb)->packet_id;
+		if (kind > prev || (scan && kind != WFX_TEST_OFFCHAN))
+			(*errors)++;
+		prev = kind;
+		num_sent++;
+		dev_kfree_skb(skb);
+	}
+}
+
+static void wfx_test_queues_get_skb(struct kunit *test)
+{
+	struct wfx_queue_test *ctx = test->priv;
+	struct wfx_dev *wdev = ctx->wdev;
+	int i, num_queued, num_sent, total = 0, errors = 0;
+	s64 delta = 0;
+
+	for (i = 0; i < WFX_TEST_LOOPS / 100; i++) {
+		num_queued = wfx_test_queues_fill(test, wdev);
+		mutex_lock(&wdev->scan_lock);
+		WRITE_ONCE(wdev->scan_paused, i % 2);
+		num_sent = wfx_test_queues_drain(wdev, !(i % 2), &errors, &delta);
+		mutex_unlock(&wdev->scan_lock);
+		num_sent += wfx_test_queues_drain(wdev, false, &errors, &delta);
+		KUNIT_EXPECT_EQ_MSG(test, num_sent, num_queued, "frames left in the queues");
+		total += num_sent;
+	}
+	KUNIT_EXPECT_EQ_MSG(test, errors, 0, "frames not sent in priority order");
+	kunit_info(test, "election among %zu vifs with cab and offchan frames: %lld ns/frame\n",
+		   ARRAY_SIZE(ctx->vifs), div_s64(delta, max(total, 1)));
+}
+
+/* The confirmations are not received in order (different ACs, retries), so the frames are
+ * retrieved at random positions of the pending queue.
+ */
+static void wfx_test_pending_get(struct kunit *test)
+{
+	static const int num_frames[] = { 16, 64, 256, 512 };
+	struct wfx_queue_test *ctx = test->priv;
+	struct wfx_dev *wdev = ctx->wdev;
+	struct wfx_vif *wvif;
+	struct sk_buff *skb;
+	int i, j, k, ac, errors;
+	ktime_t start;
+	s64 delta;
+	u32 id;
+
+	for (i = 0; i < ARRAY_SIZE(num_frames); i++) {
+		delta = 0;
+		errors = 0;
+		for (j = 0; j < max(WFX_TEST_LOOPS / num_frames[i], 1); j++) {
+			for (k = 0; k < num_frames[i]; k++) {
+				wvif = wdev_to_wvif(wdev, k % ARRAY_SIZE(ctx->vifs));
+				ac = k % IEEE80211_NUM_ACS;
+				skb = wfx_test_alloc_frame(test, wvif, ac, k | ac << 28);
+				atomic_inc(&wvif->tx_queue[ac].pending_frames);
+				skb_queue_tail(&wdev->tx_pending, skb);
+			}
+			for (k = 0; k < num_frames[i]; k++) {
+				/* 7919 is prime, so all the frames are retrieved */
+				id = (k * 7919) % num_frames[i];
+				id |= (id % IEEE80211_NUM_ACS) << 28;
+				start = ktime_get();
+				skb = wfx_pending_get(wdev, id);
+				delta += ktime_to_ns(ktime_sub(ktime_get(), start));
+				if (!skb || wfx_skb_txreq(skb)->packet_id != id)
+					errors++;
+				dev_kfree_skb(skb);
+			}
+		}
+		KUNIT_EXPECT_EQ_MSG(test, errors, 0, "wrong frames among %d", num_frames[i]);
+		KUNIT_EXPECT_TRUE(test, skb_queue_empty(&wdev->tx_pending));
+		kunit_info(test, "retrieval among %d pending frames: %lld ns/op\n", num_frames[i],
+			   div_s64(delta, j * num_frames[i]));
+	}
+	wvif = NULL;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
+		for (ac = 0; ac < IEEE80211_NUM_ACS; ac++)
+			KUNIT_EXPECT_EQ(test, atomic_read(&wvif->tx_queue[ac].pending_frames), 0);
+}
+
+static struct kunit_case wfx_queue_test_cases[] = {
+	KUNIT_CASE(wfx_test_queues_rank),
+	KUNIT_CASE(wfx_test_queues_get_skb),
+	KUNIT_CASE(wfx_test_pending_get),
+	{ }
+};
+
+static struct kunit_suite wfx_queue_test_suite = {
+	.name = "wfx-queue",
+	.init = wfx_queue_test_init,
+	.exit = wfx_queue_test_exit,
+	.test_cases = wfx_queue_test_cases,
+};
+kunit_test_suite(wfx_queue_test_suite);
@@ -6,6 +6,7 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/version.h>
+#include <linux/moduleparam.h>
 #include <net/mac80211.h>
 
 #include "scan.h"
@@ -13,6 +14,31 @@
 #include "sta.h"
 #include "hif_tx_mib.h"
 
+static bool bg_scan = true;
+module_param(bg_scan, bool, 0644);
+MODULE_PARM_DESC(bg_scan, "when associated, scan in slices and go back to the operating channel between them (default: true).");
+
+static unsigned int bg_scan_budget_ms[IEEE80211_NUM_ACS] = {
+	[IEEE80211_AC_VO] = 40,
+	[IEEE80211_AC_VI] = 80,
+	[IEEE80211_AC_BE] = 250,
+	[IEEE80211_AC_BK] = 500,
+};
+module_param_array(bg_scan_budget_ms, uint, NULL, 0644);
+MODULE_PARM_DESC(bg_scan_budget_ms, "maximum time (in ms) spent off-channel by a background scan slice while VO, VI, BE or BK traffic is running (default: 40,80,250,500).");
+
+static unsigned int bg_scan_home_ms = 50;
+module_param(bg_scan_home_ms, uint, 0644);
+MODULE_PARM_DESC(bg_scan_home_ms, "maximum time (in ms) spent on the operating channel between two slices of a background scan (default: 50).");
+
+static bool fast_rescan;
+module_param(fast_rescan, bool, 0644);
+MODULE_PARM_DESC(fast_rescan, "scan first the channels where a BSS was recently seen, and only them if all the channels were scanned recently (default: false).");
+
+static unsigned int scan_cache_ms = 30000;
+module_param(scan_cache_ms, uint, 0644);
+MODULE_PARM_DESC(scan_cache_ms, "validity (in ms) of the channels where a BSS was seen and of the last scan of all the channels (default: 30000).");
+
 #if (KERNEL_VERSION(4, 13, 0) > LINUX_VERSION_CODE)
 static inline void *skb_put_data(struct sk_buff *skb, const void *data, unsigned int len)
 {
@@ -51,18 +77,33 @@ static int update_probe_tmpl(struct wfx_vif *wvif, struct cfg80211_scan_request
 		return -ENOMEM;
 
 	skb_put_data(skb, req->ie, req->ie_len);
-	wfx_hif_set_template_frame(wvif, skb, HIF_TMPLT_PRBREQ, 0);
+	wfx_upload_template(wvif, skb, HIF_TMPLT_PRBREQ, 0);
 	dev_kfree_skb(skb);
 	return 0;
 }
 
-static int send_scan_req(struct wfx_vif *wvif, struct cfg80211_scan_request *req, int start_idx)
+/* If budget_ms is not 0, the channels scanned (and the time spent on them) are limited to not stay
+ * away from the operating channel longer than budget_ms.
+ */
+static int send_scan_req(struct wfx_vif *wvif, struct cfg80211_scan_request *req, int start_idx,
+			 unsigned int budget_ms)
 {
 	struct ieee80211_vif *vif = wvif_to_vif(wvif);
 	struct ieee80211_channel *ch_start, *ch_cur;
+	unsigned int dwell_ms = 0;
+	int max_chan = req->n_channels;
 	int i, ret;
 
-	for (i = start_idx; i < req->n_channels; i++) {
+	if (budget_ms) {
+		/* Beacons have to be caught on passive channels, their dwell time is not reduced */
+		if (req->channels[start_idx]->flags & IEEE80211_CHAN_NO_IR)
+			dwell_ms = WFX_SCAN_PASSIVE_DWELL_MS;
+		else
+			dwell_ms = clamp_t(unsigned int, budget_ms, WFX_SCAN_ACTIVE_MIN_DWELL_MS,
+					   WFX_SCAN_ACTIVE_DWELL_MS);
+		max_chan = max_t(int, budget_ms / dwell_ms, 1);
+	}
+	for (i = start_idx; i < req->n_channels && i - start_idx < max_chan; i++) {
 		ch_start = req->channels[start_idx];
 		ch_cur = req->channels[i];
 		WARN(ch_cur->band != NL80211_BAND_2GHZ, "band not supported");
@@ -72,9 +113,8 @@ static int send_scan_req(struct wfx_vif *wvif, struct cfg80211_scan_request *req
 			break;
 	}
 	wfx_tx_lock_flush(wvif->wdev);
-	wvif->scan_abort = false;
 	reinit_completion(&wvif->scan_complete);
-	ret = wfx_hif_scan(wvif, req, start_idx, i - start_idx);
+	ret = wfx_hif_scan(wvif, req, start_idx, i - start_idx, dwell_ms);
 	if (ret) {
 		wfx_tx_unlock(wvif->wdev);
 		return -EIO;
@@ -89,7 +129,7 @@ static int send_scan_req(struct wfx_vif *wvif, struct cfg80211_scan_request *req
 	if (!ret) {
 		dev_err(wvif->wdev->dev, "scan didn't stop\n");
 		ret = -ETIMEDOUT;
-	} else if (wvif->scan_abort) {
+	} else if (READ_ONCE(wvif->scan_abort)) {
 		dev_notice(wvif->wdev->dev, "scan abort\n");
 		ret = -ECONNABORTED;
 	} else if (wvif->scan_nb_chan_done > i - start_idx) {
@@ -103,6 +143,135 @@ static int send_scan_req(struct wfx_vif *wvif, struct cfg80211_scan_request *req
 	return ret;
 }
 
+static bool wfx_scan_is_background(struct wfx_dev *wdev)
+{
+	struct wfx_vif *wvif = NULL;
+
+	if (!bg_scan)
+		return false;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
+		if (wvif_to_vif(wvif)->bss_conf.assoc)
+			return true;
+	return false;
+}
+
+/* The time off-channel is limited by the most demanding AC with traffic during the last second */
+static unsigned int wfx_scan_get_budget(struct wfx_dev *wdev)
+{
+	unsigned int budget = bg_scan_budget_ms[IEEE80211_AC_BK];
+	struct wfx_queue *queue;
+	struct wfx_vif *wvif = NULL;
+	int i;
+
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			queue = &wvif->tx_queue[i];
+			if (time_before(jiffies, queue->last_put + HZ) ||
+			    atomic_read(&queue->pending_frames))
+				budget = min(budget, bg_scan_budget_ms[i]);
+		}
+	}
+	return max(budget, 1U);
+}
+
+static bool wfx_scan_queues_empty(struct wfx_dev *wdev)
+{
+	struct wfx_vif *wvif = NULL;
+	int i;
+
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
+		for (i = 0; i < IEEE80211_NUM_ACS; i++)
+			if (!wfx_tx_queue_empty(wvif, &wvif->tx_queue[i]))
+				return false;
+	return true;
+}
+
+/* Between two slices of a background scan, the device is back on the operating channel. Give it
+ * the time to send the frames queued during the slice.
+ */
+static void wfx_scan_pause(struct wfx_vif *wvif)
+{
+	struct wfx_dev *wdev = wvif->wdev;
+
+	WRITE_ONCE(wdev->scan_paused, true);
+	wfx_bh_request_tx(wdev);
+	wait_event_timeout(wdev->tx_dequeue,
+			   wfx_scan_queues_empty(wdev) || READ_ONCE(wvif->scan_abort),
+			   msecs_to_jiffies(bg_scan_home_ms));
+	WRITE_ONCE(wdev->scan_paused, false);
+}
+
+/* A passive channel takes WFX_SCAN_PASSIVE_DWELL_MS in a row. While the budget is lower, move the
+ * remaining passive channels after the remaining active ones. So, the passive channels are only
+ * scanned when there is nothing else to scan (or once the traffic allows it).
+ */
+static void wfx_scan_defer_passive(struct cfg80211_scan_request *req, int start_idx)
+{
+	struct ieee80211_channel *passive[HIF_API_MAX_NB_CHANNELS];
+	int i, n_active = start_idx, n_passive = 0;
+
+	if (req->n_channels > HIF_API_MAX_NB_CHANNELS)
+		return;
+	for (i = start_idx; i < req->n_channels; i++) {
+		if (req->channels[i]->flags & IEEE80211_CHAN_NO_IR)
+			passive[n_passive++] = req->channels[i];
+		else
+			req->channels[n_active++] = req->channels[i];
+	}
+	memcpy(req->channels + n_active, passive, n_passive * sizeof(passive[0]));
+}
+
+static bool wfx_scan_is_recent(unsigned long timestamp)
+{
+	return timestamp && time_before(jiffies, timestamp + msecs_to_jiffies(scan_cache_ms));
+}
+
+/* Return a copy of req where the channels with a BSS seen recently come first. If all the
+ * channels were scanned recently, the other channels are not scanned. Return NULL if there is
+ * nothing to change.
+ */
+static struct cfg80211_scan_request *wfx_scan_fast_req(struct wfx_dev *wdev,
+						       struct cfg80211_scan_request *req)
+{
+	DECLARE_BITMAP(cached, HIF_API_MAX_NB_CHANNELS) = { };
+	struct cfg80211_scan_request *fast;
+	struct ieee80211_channel *ch;
+	int i, n = 0;
+
+	if (!fast_rescan || req->n_channels > HIF_API_MAX_NB_CHANNELS)
+		return NULL;
+	for (i = 0; i < req->n_channels; i++) {
+		ch = req->channels[i];
+		if (ch->hw_value < ARRAY_SIZE(wdev->scan_bss_seen) &&
+		    wfx_scan_is_recent(READ_ONCE(wdev->scan_bss_seen[ch->hw_value]))) {
+			__set_bit(i, cached);
+			n++;
+		}
+	}
+	if (!n)
+		return NULL;
+	fast = kmalloc(struct_size(req, channels, req->n_channels), GFP_KERNEL);
+	if (!fast)
+		return NULL;
+	memcpy(fast, req, sizeof(*req));
+	n = 0;
+	for (i = 0; i < req->n_channels; i++)
+		if (test_bit(i, cached))
+			fast->channels[n++] = req->channels[i];
+	if (!wfx_scan_is_recent(wdev->scan_last_full))
+		for (i = 0; i < req->n_channels; i++)
+			if (!test_bit(i, cached))
+				fast->channels[n++] = req->channels[i];
+	fast->n_channels = n;
+	return fast;
+}
+
+void wfx_scan_bss_seen(struct wfx_dev *wdev, int channel)
+{
+	if (channel > 0 && channel < ARRAY_SIZE(wdev->scan_bss_seen))
+		WRITE_ONCE(wdev->scan_bss_seen[channel], jiffies);
+}
+
 /* It is not really necessary to run scan request asynchronously. However,
  * there is a bug in "iw scan" when ieee80211_scan_completed() is called before
  * wfx_hw_scan() return
@@ -111,7 +280,11 @@ void wfx_hw_scan_work(struct work_struct *work)
 {
 	struct wfx_vif *wvif = container_of(work, struct wfx_vif, scan_work);
 	struct ieee80211_scan_request *hw_req = wvif->scan_req;
+	struct wfx_dev *wdev = wvif->wdev;
+	struct cfg80211_scan_request *req, *req_copy;
+	unsigned int budget = 0;
 	int chan_cur, ret, err;
+	bool background;
 
 	mutex_lock(&wvif->wdev->conf_mutex);
 	mutex_lock(&wvif->wdev->scan_lock);
@@ -120,10 +293,24 @@ void wfx_hw_scan_work(struct work_struct *work)
 		wfx_reset(wvif);
 	}
 	update_probe_tmpl(wvif, &hw_req->req);
+	background = wfx_scan_is_background(wvif->wdev);
+	req_copy = wfx_scan_fast_req(wdev, &hw_req->req);
+	/* wfx_scan_defer_passive() changes the order of the channels, so it needs a copy */
+	if (background && !req_copy)
+		req_copy = kmemdup(&hw_req->req,
+				   struct_size(&hw_req->req, channels, hw_req->req.n_channels),
+				   GFP_KERNEL);
+	req = req_copy ? req_copy : &hw_req->req;
+	WRITE_ONCE(wvif->scan_abort, false);
 	chan_cur = 0;
 	err = 0;
 	do {
-		ret = send_scan_req(wvif, &hw_req->req, chan_cur);
+		if (background) {
+			budget = wfx_scan_get_budget(wvif->wdev);
+			if (req_copy && budget < WFX_SCAN_PASSIVE_DWELL_MS)
+				wfx_scan_defer_passive(req, chan_cur);
+		}
+		ret = send_scan_req(wvif, req, chan_cur, budget);
 		if (ret > 0) {
 			chan_cur += ret;
 			err = 0;
@@ -134,7 +321,16 @@ void wfx_hw_scan_work(struct work_struct *work)
 			dev_err(wvif->wdev->dev, "scan has not been able to start\n");
 			ret = -ETIMEDOUT;
 		}
-	} while (ret >= 0 && chan_cur < hw_req->req.n_channels);
+		if (background && ret >= 0 && chan_cur < req->n_channels) {
+			wfx_scan_pause(wvif);
+			/* wfx_cancel_hw_scan() has no scan to stop during the pause */
+			if (READ_ONCE(wvif->scan_abort))
+				ret = -ECONNABORTED;
+		}
+	} while (ret >= 0 && chan_cur < req->n_channels);
+	if (ret >= 0 && req->n_channels >= wdev->hw->wiphy->bands[NL80211_BAND_2GHZ]->n_channels)
+		wdev->scan_last_full = jiffies;
+	kfree(req_copy);
 	mutex_unlock(&wvif->wdev->scan_lock);
 	mutex_unlock(&wvif->wdev->conf_mutex);
 	wfx_ieee80211_scan_completed_compat(wvif->wdev->hw, ret < 0);
@@ -155,7 +351,9 @@ void wfx_cancel_hw_scan(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 {
 	struct wfx_vif *wvif = (struct wfx_vif *)vif->drv_priv;
 
-	wvif->scan_abort = true;
+	WRITE_ONCE(wvif->scan_abort, true);
+	/* wfx_scan_pause() may be waiting for the queues to drain */
+	wake_up(&wvif->wdev->tx_dequeue);
 	wfx_hif_stop_scan(wvif);
 }
 
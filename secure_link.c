@@ -7,7 +7,13 @@
 #include <linux/module.h>
 #include <linux/random.h>
 #include <linux/version.h>
+#include <linux/seq_buf.h>
+#include <linux/seq_file.h>
+#include <linux/scatterlist.h>
+#include <linux/timex.h>
+#include <crypto/aead.h>
 #include <mbedtls/md.h>
+#include <mbedtls/bignum.h>
 #include <mbedtls/ecdh.h>
 #include <mbedtls/ccm.h>
 #include <mbedtls/sha256.h>
@@ -21,6 +27,11 @@
 
 #include "secure_link.h"
 #include "wfx.h"
+#include "traces.h"
+
+#if (KERNEL_VERSION(5, 9, 0) > LINUX_VERSION_CODE)
+#define kfree_sensitive(x) kzfree(x)
+#endif
 
 static char *slk_key;
 module_param(slk_key, charp, 0600);
@@ -34,6 +45,24 @@ static unsigned int slk_renew_period = BIT(29);
 module_param(slk_renew_period, int, 0644);
 MODULE_PARM_DESC(slk_renew_period, "number of secure link messages before renewing the key (default: 2^29).");
 
+static bool slk_kcrypto = true;
+module_param(slk_kcrypto, bool, 0644);
+MODULE_PARM_DESC(slk_kcrypto, "use kernel crypto API (and its hardware accelerators) to encrypt secure link messages if available (default: true).");
+
+#define WFX_SL_NONCE_SIZE 12
+#define WFX_SL_BENCH_LOOPS 1000
+#define WFX_SL_BENCH_PK_LOOPS 16
+/* QoS data frame carrying a 1500-byte MSDU */
+#define WFX_SL_BENCH_FRAME_LEN 1534
+#define WFX_SL_BENCH_MSG_MAX 2048
+#define WFX_SL_BENCH_REPORT_SIZE 8192
+
+struct wfx_sl_aead {
+	struct crypto_aead  *tfm;
+	struct aead_request *req;
+	u8                  iv[16];
+};
+
 void mbedtls_platform_zeroize(void *buf, size_t len)
 {
 	memset(buf, 0, len);
@@ -46,22 +75,274 @@ static int mbedtls_random(void *data, unsigned char *output, size_t len)
 	return 0;
 }
 
+#ifdef WFX_SL_KCRYPTO
+static void wfx_sl_aead_free(struct wfx_sl_aead *aead)
+{
+	if (!aead)
+		return;
+	aead_request_free(aead->req);
+	crypto_free_aead(aead->tfm);
+	kfree_sensitive(aead);
+}
+
+static struct wfx_sl_aead *wfx_sl_aead_alloc(void)
+{
+	struct wfx_sl_aead *aead;
+	int ret;
+
+	aead = kzalloc(sizeof(*aead), GFP_KERNEL);
+	if (!aead)
+		return ERR_PTR(-ENOMEM);
+	aead->tfm = crypto_alloc_aead("ccm(aes)", 0, 0);
+	if (IS_ERR(aead->tfm)) {
+		ret = PTR_ERR(aead->tfm);
+		kfree(aead);
+		return ERR_PTR(ret);
+	}
+	aead->req = aead_request_alloc(aead->tfm, GFP_KERNEL);
+	if (!aead->req) {
+		wfx_sl_aead_free(aead);
+		return ERR_PTR(-ENOMEM);
+	}
+	ret = crypto_aead_setauthsize(aead->tfm, sizeof(struct wfx_hif_sl_tag));
+	if (ret) {
+		wfx_sl_aead_free(aead);
+		return ERR_PTR(ret);
+	}
+	return aead;
+}
+
+static int wfx_sl_aead_setkey(struct wfx_sl_aead *aead, const u8 *key, size_t len)
+{
+	return crypto_aead_setkey(aead->tfm, key, len);
+}
+
+static const char *wfx_sl_aead_name(struct wfx_sl_aead *aead)
+{
+	return crypto_tfm_alg_driver_name(crypto_aead_tfm(aead->tfm));
+}
+
+/* When encrypting, dst must have room for the tag. When decrypting, src is followed by the tag.
+ * Kernel does not support partially overlapping buffers, but src == dst is allowed.
+ */
+static int wfx_sl_aead_crypt(struct wfx_sl_aead *aead, bool encrypt, const u32 *nonce,
+			     const u8 *src, u8 *dst, size_t len)
+{
+	size_t src_len = encrypt ? len : len + sizeof(struct wfx_hif_sl_tag);
+	size_t dst_len = encrypt ? len + sizeof(struct wfx_hif_sl_tag) : len;
+	struct scatterlist sg_src, sg_dst;
+	DECLARE_CRYPTO_WAIT(wait);
+	int ret;
+
+	/* First byte of IV contains L - 1 where L is the size of the length field (15 - 12) */
+	memset(aead->iv, 0, sizeof(aead->iv));
+	aead->iv[0] = 15 - WFX_SL_NONCE_SIZE - 1;
+	memcpy(aead->iv + 1, nonce, WFX_SL_NONCE_SIZE);
+	if (src == dst) {
+		sg_init_one(&sg_src, src, len + sizeof(struct wfx_hif_sl_tag));
+	} else {
+		sg_init_one(&sg_src, src, src_len);
+		sg_init_one(&sg_dst, dst, dst_len);
+	}
+	aead_request_set_callback(aead->req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+				  crypto_req_done, &wait);
+	aead_request_set_ad(aead->req, 0);
+	aead_request_set_crypt(aead->req, &sg_src, src != dst ? &sg_dst : &sg_src, src_len,
+			       aead->iv);
+	if (encrypt)
+		ret = crypto_aead_encrypt(aead->req);
+	else
+		ret = crypto_aead_decrypt(aead->req);
+	return crypto_wait_req(ret, &wait);
+}
+
+/* Check kernel implementation gives the same result than mbedtls */
+static int wfx_sl_aead_selftest(struct wfx_sl_aead *aead)
+{
+	const size_t len = 64;
+	const size_t tag_len = sizeof(struct wfx_hif_sl_tag);
+	struct {
+		mbedtls_ccm_context ccm;
+		u8 key[16];
+		u8 clear[64];
+		u8 ref[64 + sizeof(struct wfx_hif_sl_tag)];
+		u8 out[64 + sizeof(struct wfx_hif_sl_tag)];
+	} *t;
+	u32 nonce[3];
+	int ret;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+	get_random_bytes(t->key, sizeof(t->key));
+	get_random_bytes(t->clear, sizeof(t->clear));
+	get_random_bytes(nonce, sizeof(nonce));
+	mbedtls_ccm_init(&t->ccm);
+	ret = mbedtls_ccm_setkey(&t->ccm, MBEDTLS_CIPHER_ID_AES, t->key, sizeof(t->key) * 8);
+	if (!ret)
+		ret = mbedtls_ccm_encrypt_and_tag(&t->ccm, len, (u8 *)nonce, sizeof(nonce), NULL, 0,
+						  t->clear, t->ref, t->ref + len, tag_len);
+	if (ret) {
+		ret = -EIO;
+		goto end;
+	}
+	ret = wfx_sl_aead_setkey(aead, t->key, sizeof(t->key));
+	if (!ret)
+		ret = wfx_sl_aead_crypt(aead, true, nonce, t->clear, t->out, len);
+	if (ret)
+		goto end;
+	if (memcmp(t->out, t->ref, sizeof(t->ref))) {
+		ret = -EBADMSG;
+		goto end;
+	}
+	ret = wfx_sl_aead_crypt(aead, false, nonce, t->out, t->out, len);
+	if (!ret && memcmp(t->out, t->clear, len))
+		ret = -EBADMSG;
+end:
+	mbedtls_ccm_free(&t->ccm);
+	kfree_sensitive(t);
+	return ret;
+}
+
+static void wfx_sl_backend_init(struct wfx_dev *wdev)
+{
+	struct wfx_sl_aead *aead;
+
+	if (wdev->sl.aead)
+		return;
+	aead = wfx_sl_aead_alloc();
+	if (IS_ERR(aead)) {
+		dev_info(wdev->dev, "kernel does not provide ccm(aes), use mbedtls for secure link: %ld\n",
+			 PTR_ERR(aead));
+		wdev->sl.aead_selftest = PTR_ERR(aead);
+		return;
+	}
+	wdev->sl.aead_selftest = wfx_sl_aead_selftest(aead);
+	if (wdev->sl.aead_selftest) {
+		dev_err(wdev->dev, "self-test of %s failed, use mbedtls for secure link: %d\n",
+			wfx_sl_aead_name(aead), wdev->sl.aead_selftest);
+		wfx_sl_aead_free(aead);
+		return;
+	}
+	dev_dbg(wdev->dev, "secure link may use %s\n", wfx_sl_aead_name(aead));
+	mutex_lock(&wdev->sl.aead_lock);
+	wdev->sl.aead = aead;
+	mutex_unlock(&wdev->sl.aead_lock);
+}
+
+static void wfx_sl_backend_deinit(struct wfx_dev *wdev)
+{
+	mutex_lock(&wdev->sl.aead_lock);
+	wfx_sl_aead_free(wdev->sl.aead);
+	wdev->sl.aead = NULL;
+	mutex_unlock(&wdev->sl.aead_lock);
+}
+
+static struct wfx_sl_aead *wfx_sl_get_aead(struct wfx_dev *wdev)
+{
+	return slk_kcrypto ? wdev->sl.aead : NULL;
+}
+#else
+static void wfx_sl_aead_free(struct wfx_sl_aead *aead)
+{
+}
+
+static struct wfx_sl_aead *wfx_sl_aead_alloc(void)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static int wfx_sl_aead_setkey(struct wfx_sl_aead *aead, const u8 *key, size_t len)
+{
+	return -EOPNOTSUPP;
+}
+
+static int wfx_sl_aead_crypt(struct wfx_sl_aead *aead, bool encrypt, const u32 *nonce,
+			     const u8 *src, u8 *dst, size_t len)
+{
+	return -EOPNOTSUPP;
+}
+
+static void wfx_sl_backend_init(struct wfx_dev *wdev)
+{
+	wdev->sl.aead_selftest = -EOPNOTSUPP;
+}
+
+static void wfx_sl_backend_deinit(struct wfx_dev *wdev)
+{
+}
+
+static struct wfx_sl_aead *wfx_sl_get_aead(struct wfx_dev *wdev)
+{
+	return NULL;
+}
+
+static const char *wfx_sl_aead_name(struct wfx_sl_aead *aead)
+{
+	return "none";
+}
+#endif
+
 int wfx_is_secure_command(struct wfx_dev *wdev, int cmd_id)
 {
 	return test_bit(cmd_id, wdev->sl.commands);
 }
 
+/* Encrypt input into output. The tag is written just after the padded payload. */
+static int wfx_sl_seal(mbedtls_ccm_context *ccm, struct wfx_sl_aead *aead, const u32 *nonce,
+		       const struct wfx_hif_msg *input, struct wfx_hif_sl_msg *output)
+{
+	size_t payload_len = round_up(le16_to_cpu(input->len) - sizeof(input->len), 16);
+
+	output->len = input->len;
+	if (aead)
+		return wfx_sl_aead_crypt(aead, true, nonce, (u8 *)input + sizeof(input->len),
+					 output->payload, payload_len);
+	return mbedtls_ccm_encrypt_and_tag(ccm, payload_len, (u8 *)nonce, WFX_SL_NONCE_SIZE, NULL, 0,
+					   (u8 *)input + sizeof(input->len), output->payload,
+					   output->payload + payload_len,
+					   sizeof(struct wfx_hif_sl_tag));
+}
+
+/* Decrypt m in place. On success, the clear message (starting with its length) is at the start
+ * of m. The header of m is overwritten.
+ */
+static int wfx_sl_unseal(mbedtls_ccm_context *ccm, struct wfx_sl_aead *aead, const u32 *nonce,
+			 struct wfx_hif_sl_msg *m)
+{
+	size_t payload_len = round_up(le16_to_cpu(m->len) - sizeof(m->len), 16);
+	u8 *tag = m->payload + payload_len;
+	u8 *output = (u8 *)m;
+	int ret;
+
+	memcpy(output, &m->len, sizeof(m->len));
+	if (aead) {
+		/* Decrypt in place, then shift the result over the header */
+		ret = wfx_sl_aead_crypt(aead, false, nonce, m->payload, m->payload, payload_len);
+		if (!ret)
+			memmove(output + sizeof(m->len), m->payload, payload_len);
+		return ret;
+	}
+	return mbedtls_ccm_auth_decrypt(ccm, payload_len, (u8 *)nonce, WFX_SL_NONCE_SIZE, NULL, 0,
+					m->payload, output + sizeof(m->len),
+					tag, sizeof(struct wfx_hif_sl_tag));
+}
+
 int wfx_sl_decode(struct wfx_dev *wdev, struct wfx_hif_sl_msg *m)
 {
 	int ret;
 	size_t clear_len = le16_to_cpu(m->len);
 	size_t payload_len = round_up(clear_len - sizeof(m->len), 16);
-	u8 *tag = m->payload + payload_len;
 	u8 *output = (u8 *)m;
 	u32 nonce[3] = { };
 
 	WARN(m->hdr.encrypted != 0x02, "packet is not encrypted");
 
+	/* The chip already uses the new key. The bh sets key_state, so it cannot change here. */
+	if (READ_ONCE(wdev->sl.key_state) == WFX_SL_KEY_SWITCH &&
+	    !wait_for_completion_timeout(&wdev->sl.key_switched, msecs_to_jiffies(500)))
+		dev_warn(wdev->dev, "new secure link key is not ready\n");
+
 	/* Other bytes of nonce are 0 */
 	nonce[1] = m->hdr.seqnum;
 	if (wdev->sl.rx_seqnum != m->hdr.seqnum)
@@ -71,12 +352,11 @@ int wfx_sl_decode(struct wfx_dev *wdev, struct wfx_hif_sl_msg *m)
 	if (wdev->sl.rx_seqnum == slk_renew_period)
 		schedule_work(&wdev->sl.key_renew_work);
 
-	memcpy(output, &m->len, sizeof(m->len));
-	ret = mbedtls_ccm_auth_decrypt(&wdev->sl.ccm_ctxt, payload_len, (u8 *)nonce, sizeof(nonce),
-				       NULL, 0, m->payload, output + sizeof(m->len),
-				       tag, sizeof(struct wfx_hif_sl_tag));
+	mutex_lock(&wdev->sl.aead_lock);
+	ret = wfx_sl_unseal(&wdev->sl.ccm_ctxt, wfx_sl_get_aead(wdev), nonce, m);
+	mutex_unlock(&wdev->sl.aead_lock);
 	if (ret) {
-		dev_err(wdev->dev, "mbedtls error: %08x\n", ret);
+		dev_err(wdev->dev, "crypto error: %d\n", ret);
 		return -EIO;
 	}
 	if (memzcmp(output + clear_len, payload_len + sizeof(m->len) - clear_len))
@@ -87,13 +367,10 @@ int wfx_sl_decode(struct wfx_dev *wdev, struct wfx_hif_sl_msg *m)
 int wfx_sl_encode(struct wfx_dev *wdev,
 		  const struct wfx_hif_msg *input, struct wfx_hif_sl_msg *output)
 {
-	int payload_len = round_up(le16_to_cpu(input->len) - sizeof(input->len), 16);
-	u8 *tag = output->payload + payload_len;
 	u32 nonce[3] = { };
 	int ret;
 
 	output->hdr.encrypted = 0x1;
-	output->len = input->len;
 	output->hdr.seqnum = wdev->sl.tx_seqnum;
 	/* Other bytes of nonce are 0 */
 	nonce[2] = wdev->sl.tx_seqnum;
@@ -101,17 +378,104 @@ int wfx_sl_encode(struct wfx_dev *wdev,
 	if (wdev->sl.tx_seqnum == slk_renew_period)
 		schedule_work(&wdev->sl.key_renew_work);
 
-	ret = mbedtls_ccm_encrypt_and_tag(&wdev->sl.ccm_ctxt, payload_len,
-					  (u8 *)nonce, sizeof(nonce), NULL, 0,
-					  (u8 *)input + sizeof(input->len), output->payload,
-					  tag, sizeof(struct wfx_hif_sl_tag));
+	mutex_lock(&wdev->sl.aead_lock);
+	ret = wfx_sl_seal(&wdev->sl.ccm_ctxt, wfx_sl_get_aead(wdev), nonce, input, output);
+	mutex_unlock(&wdev->sl.aead_lock);
 	if (ret) {
-		dev_err(wdev->dev, "mbedtls error: %08x\n", ret);
+		dev_err(wdev->dev, "crypto error: %d\n", ret);
 		return -EIO;
 	}
 	return 0;
 }
 
+static const struct {
+	const char *name;
+	size_t len;
+} wfx_sl_bench_msgs[] = {
+	{ "TX confirmation", sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_cnf_tx) },
+	{ "TX request",
+	  sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_req_tx) + WFX_SL_BENCH_FRAME_LEN },
+	{ "RX indication",
+	  sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_ind_rx) + WFX_SL_BENCH_FRAME_LEN },
+};
+
+/* Encode then decode HIF messages through the same path than the traffic. Bytes are counted in
+ * both directions. Note that get_cycles() counts timer ticks on some architectures.
+ */
+static void wfx_sl_bench_msgs_run(struct seq_buf *seq, const char *backend,
+				  mbedtls_ccm_context *ccm, struct wfx_sl_aead *aead,
+				  u8 *clear, u8 *buf)
+{
+	struct wfx_hif_msg *msg = (struct wfx_hif_msg *)clear;
+	struct wfx_hif_sl_msg *sl_msg = (struct wfx_hif_sl_msg *)buf;
+	u32 nonce[3] = { };
+	cycles_t cycles;
+	ktime_t start;
+	s64 delta, bytes;
+	size_t len;
+	int i, j, ret;
+
+	for (j = 0; j < ARRAY_SIZE(wfx_sl_bench_msgs); j++) {
+		len = wfx_sl_bench_msgs[j].len;
+		memset(clear, 0, WFX_SL_BENCH_MSG_MAX);
+		get_random_bytes(clear, len);
+		msg->len = cpu_to_le16(len);
+		ret = 0;
+		start = ktime_get();
+		cycles = get_cycles();
+		for (i = 0; i < WFX_SL_BENCH_LOOPS && !ret; i++) {
+			nonce[2] = i;
+			ret = wfx_sl_seal(ccm, aead, nonce, msg, sl_msg);
+			if (!ret)
+				ret = wfx_sl_unseal(ccm, aead, nonce, sl_msg);
+		}
+		cycles = get_cycles() - cycles;
+		delta = ktime_to_ns(ktime_sub(ktime_get(), start)) ? : 1;
+		if (!ret && memcmp(buf, clear, len))
+			ret = -EBADMSG;
+		if (ret) {
+			seq_buf_printf(seq, "  %s, %s: error %d\n", backend,
+				       wfx_sl_bench_msgs[j].name, ret);
+			continue;
+		}
+		bytes = 2 * (s64)len * WFX_SL_BENCH_LOOPS;
+		seq_buf_printf(seq,
+			       "  %s, %s (%zu bytes): %lld msg/s, %lld KiB/s, %lld.%02lld cycles/byte\n",
+			       backend, wfx_sl_bench_msgs[j].name, len,
+			       div64_s64((s64)WFX_SL_BENCH_LOOPS * NSEC_PER_SEC, delta),
+			       div64_s64(bytes * NSEC_PER_SEC / 1024, delta),
+			       div64_s64((s64)cycles, bytes),
+			       div64_s64((s64)cycles * 100, bytes) % 100);
+	}
+}
+
+static void wfx_sl_bench_roundtrip(struct seq_buf *seq, mbedtls_ccm_context *ccm, const u8 *key,
+				   u8 *clear, u8 *buf)
+{
+	struct wfx_sl_aead *aead;
+	int ret;
+
+	mbedtls_ccm_init(ccm);
+	ret = mbedtls_ccm_setkey(ccm, MBEDTLS_CIPHER_ID_AES, key, 16 * BITS_PER_BYTE);
+	if (ret)
+		seq_buf_printf(seq, "  mbedtls: error %08x\n", ret);
+	else
+		wfx_sl_bench_msgs_run(seq, "mbedtls", ccm, NULL, clear, buf);
+	mbedtls_ccm_free(ccm);
+
+	aead = wfx_sl_aead_alloc();
+	if (IS_ERR(aead)) {
+		seq_buf_printf(seq, "  kernel: not available (%ld)\n", PTR_ERR(aead));
+		return;
+	}
+	ret = wfx_sl_aead_setkey(aead, key, 16);
+	if (ret)
+		seq_buf_printf(seq, "  kernel %s: error %d\n", wfx_sl_aead_name(aead), ret);
+	else
+		wfx_sl_bench_msgs_run(seq, "kernel", NULL, aead, clear, buf);
+	wfx_sl_aead_free(aead);
+}
+
 static int wfx_sl_get_pubkey_mac(struct wfx_dev *wdev, const u8 *pubkey, u8 *mac)
 {
 	return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA512),
@@ -120,103 +484,287 @@ static int wfx_sl_get_pubkey_mac(struct wfx_dev *wdev, const u8 *pubkey, u8 *mac
 			       mac);
 }
 
-int wfx_sl_check_pubkey(struct wfx_dev *wdev, const u8 *pubkey_orig, const u8 *mac)
+/* Compute the AES key shared with the owner of pubkey (in the byte order of the chip) */
+static int wfx_sl_compute_key(mbedtls_ecdh_context *ecdh, const u8 *pubkey_orig,
+			      u8 key[SHA256_DIGEST_SIZE])
 {
 	int ret;
 	size_t olen;
 	u8 pubkey[API_NCP_PUB_KEY_SIZE];
 	u8 secret[API_HOST_PUB_KEY_SIZE];
-	u8 secret_digest[SHA256_DIGEST_SIZE];
-	u8 expected_mac[SHA512_DIGEST_SIZE];
-
-	memcpy(pubkey, pubkey_orig, sizeof(pubkey));
-	ret = wfx_sl_get_pubkey_mac(wdev, pubkey, expected_mac);
-	if (ret)
-		goto end;
-	ret = memcmp(expected_mac, mac, sizeof(expected_mac));
-	if (ret)
-		goto end;
 
 	/* FIXME: save Qp.Y or (reset it), concat it with ncp_public_key and use
 	 * mbedtls_ecdh_read_public.
 	 */
+	memcpy(pubkey, pubkey_orig, sizeof(pubkey));
 	memreverse(pubkey, sizeof(pubkey));
-	ret = mbedtls_mpi_read_binary(&wdev->sl.edch_ctxt.Qp.X, pubkey, API_NCP_PUB_KEY_SIZE);
+	ret = mbedtls_mpi_read_binary(&ecdh->Qp.X, pubkey, API_NCP_PUB_KEY_SIZE);
 	if (ret)
 		goto end;
-	ret = mbedtls_mpi_lset(&wdev->sl.edch_ctxt.Qp.Z, 1);
+	ret = mbedtls_mpi_lset(&ecdh->Qp.Z, 1);
 	if (ret)
 		goto end;
 
-	ret = mbedtls_ecdh_calc_secret(&wdev->sl.edch_ctxt, &olen, secret, sizeof(secret),
-				       mbedtls_random, NULL);
+	ret = mbedtls_ecdh_calc_secret(ecdh, &olen, secret, sizeof(secret), mbedtls_random, NULL);
 	if (ret)
 		goto end;
 
 	memreverse(secret, sizeof(secret));
-	ret = mbedtls_sha256_ret(secret, sizeof(secret), secret_digest, 0);
-	if (ret)
-		goto end;
-
-	wdev->sl.rx_seqnum = 0;
-	wdev->sl.tx_seqnum = 0;
-	mbedtls_ccm_free(&wdev->sl.ccm_ctxt);
-	/* Use the lower 16 bytes of the sha256 of the secret for AES key */
-	ret = mbedtls_ccm_setkey(&wdev->sl.ccm_ctxt, MBEDTLS_CIPHER_ID_AES,
-				 secret_digest, 16 * BITS_PER_BYTE);
+	ret = mbedtls_sha256_ret(secret, sizeof(secret), key, 0);
 
 end:
+	memzero_explicit(secret, sizeof(secret));
+	return ret;
+}
+
+/* Called by the bh when the chip sends its public key. The encrypted messages that follow this
+ * indication use the new key. Computing the key is expensive, so it is done by the caller of
+ * wfx_sl_send_pubkey() and the bh only waits for it if it has to decrypt a message in the meantime
+ * (the data frames are not encrypted).
+ */
+int wfx_sl_check_pubkey(struct wfx_dev *wdev, const u8 *pubkey, const u8 *mac)
+{
+	mutex_lock(&wdev->sl.aead_lock);
+	if (wdev->sl.key_state != WFX_SL_KEY_EXCHANGE) {
+		mutex_unlock(&wdev->sl.aead_lock);
+		dev_warn(wdev->dev, "unexpected secure link public key\n");
+		return 0;
+	}
+	memcpy(wdev->sl.peer_pubkey, pubkey, sizeof(wdev->sl.peer_pubkey));
+	memcpy(wdev->sl.peer_pubkey_mac, mac, sizeof(wdev->sl.peer_pubkey_mac));
+	WRITE_ONCE(wdev->sl.key_state, WFX_SL_KEY_SWITCH);
+	mutex_unlock(&wdev->sl.aead_lock);
 	complete(&wdev->sl.key_renew_done);
 	return 0;
 }
 
-static int wfx_sl_key_exchange(struct wfx_dev *wdev)
+/* Compute the key announced by the chip and use it. The chip already uses this key, so the
+ * previous key is only kept if the new one cannot be computed.
+ */
+static int wfx_sl_switch_key(struct wfx_dev *wdev)
+{
+	u8 secret_digest[SHA256_DIGEST_SIZE];
+	u8 expected_mac[SHA512_DIGEST_SIZE];
+	int ret;
+
+	ret = wfx_sl_get_pubkey_mac(wdev, wdev->sl.peer_pubkey, expected_mac);
+	if (!ret)
+		ret = memcmp(expected_mac, wdev->sl.peer_pubkey_mac, sizeof(expected_mac));
+	if (!ret)
+		ret = wfx_sl_compute_key(&wdev->sl.keypair->ecdh, wdev->sl.peer_pubkey,
+					 secret_digest);
+	if (!ret) {
+		/* The new key is prepared aside */
+		mbedtls_ccm_init(&wdev->sl.ccm_next);
+		/* Use the lower 16 bytes of the sha256 of the secret for AES key */
+		ret = mbedtls_ccm_setkey(&wdev->sl.ccm_next, MBEDTLS_CIPHER_ID_AES,
+					 secret_digest, 16 * BITS_PER_BYTE);
+		if (ret)
+			mbedtls_ccm_free(&wdev->sl.ccm_next);
+	}
+
+	mutex_lock(&wdev->sl.aead_lock);
+	if (!ret) {
+		if (wdev->sl.aead && wfx_sl_aead_setkey(wdev->sl.aead, secret_digest, 16)) {
+			dev_err(wdev->dev, "cannot set key of kernel crypto, fall back to mbedtls\n");
+			wfx_sl_aead_free(wdev->sl.aead);
+			wdev->sl.aead = NULL;
+		}
+		swap(wdev->sl.ccm_ctxt, wdev->sl.ccm_next);
+		wdev->sl.rx_seqnum = 0;
+		wdev->sl.tx_seqnum = 0;
+	}
+	WRITE_ONCE(wdev->sl.key_state, WFX_SL_KEY_STABLE);
+	mutex_unlock(&wdev->sl.aead_lock);
+	complete_all(&wdev->sl.key_switched);
+	/* ccm_next now contains the previous key */
+	if (!ret)
+		mbedtls_ccm_free(&wdev->sl.ccm_next);
+	memzero_explicit(secret_digest, sizeof(secret_digest));
+	return ret ? -EIO : 0;
+}
+
+/* On success, the caller is responsible to call mbedtls_ecdh_free() */
+static int wfx_sl_make_keypair(mbedtls_ecdh_context *ecdh, u8 *pubkey)
 {
 	int ret;
 	size_t olen;
-	u8 mac[SHA512_DIGEST_SIZE];
-	u8 pubkey[API_HOST_PUB_KEY_SIZE + 2];
+	u8 buf[API_HOST_PUB_KEY_SIZE + 2];
 
-	mbedtls_ecdh_init(&wdev->sl.edch_ctxt);
-	ret = mbedtls_ecdh_setup(&wdev->sl.edch_ctxt, MBEDTLS_ECP_DP_CURVE25519);
+	mbedtls_ecdh_init(ecdh);
+	ret = mbedtls_ecdh_setup(ecdh, MBEDTLS_ECP_DP_CURVE25519);
 	if (ret)
 		goto err;
-	wdev->sl.edch_ctxt.point_format = MBEDTLS_ECP_PF_COMPRESSED;
-	ret = mbedtls_ecdh_make_public(&wdev->sl.edch_ctxt, &olen, pubkey, sizeof(pubkey),
-				       mbedtls_random, NULL);
-	if (ret || olen != sizeof(pubkey))
+	ecdh->point_format = MBEDTLS_ECP_PF_COMPRESSED;
+	ret = mbedtls_ecdh_make_public(ecdh, &olen, buf, sizeof(buf), mbedtls_random, NULL);
+	if (ret || olen != sizeof(buf))
 		goto err;
-	memreverse(pubkey + 2, sizeof(pubkey) - 2);
-	ret = wfx_sl_get_pubkey_mac(wdev, pubkey + 2, mac);
-	if (ret)
-		goto err;
-	ret = wfx_hif_sl_send_pub_keys(wdev, pubkey + 2, mac);
-	if (ret)
-		goto err;
-	if (wdev->poll_irq)
-		wfx_bh_poll_irq(wdev);
-	if (!wait_for_completion_timeout(&wdev->sl.key_renew_done, msecs_to_jiffies(500)))
-		goto err;
-	if (!memzcmp(&wdev->sl.ccm_ctxt, sizeof(wdev->sl.ccm_ctxt)))
-		goto err;
-
-	mbedtls_ecdh_free(&wdev->sl.edch_ctxt);
+	memreverse(buf + 2, sizeof(buf) - 2);
+	memcpy(pubkey, buf + 2, API_HOST_PUB_KEY_SIZE);
 	return 0;
 err:
-	mbedtls_ecdh_free(&wdev->sl.edch_ctxt);
-	dev_err(wdev->dev, "key negociation error\n");
+	mbedtls_ecdh_free(ecdh);
 	return -EIO;
 }
 
+static struct wfx_sl_keypair *wfx_sl_keypair_alloc(void)
+{
+	struct wfx_sl_keypair *keypair;
+
+	keypair = kzalloc(sizeof(*keypair), GFP_KERNEL);
+	if (!keypair)
+		return NULL;
+	if (wfx_sl_make_keypair(&keypair->ecdh, keypair->pubkey)) {
+		kfree_sensitive(keypair);
+		return NULL;
+	}
+	return keypair;
+}
+
+static void wfx_sl_keypair_free(struct wfx_sl_keypair *keypair)
+{
+	if (!keypair)
+		return;
+	mbedtls_ecdh_free(&keypair->ecdh);
+	kfree_sensitive(keypair);
+}
+
+/* Generation of the key pairs is not time critical. Run it on an unbound workqueue, so it does
+ * not compete with the bh.
+ */
+static void wfx_sl_keypair_work(struct work_struct *work)
+{
+	struct wfx_dev *wdev = container_of(work, struct wfx_dev, sl.keypair_work);
+	struct wfx_sl_keypair *keypair;
+	int i, slot;
+
+	for (;;) {
+		mutex_lock(&wdev->sl.keypair_lock);
+		slot = -1;
+		for (i = 0; i < ARRAY_SIZE(wdev->sl.keypairs); i++)
+			if (!wdev->sl.keypairs[i])
+				slot = i;
+		mutex_unlock(&wdev->sl.keypair_lock);
+		if (slot < 0)
+			break;
+		keypair = wfx_sl_keypair_alloc();
+		if (!keypair)
+			break;
+		/* Only this work fills the slots */
+		mutex_lock(&wdev->sl.keypair_lock);
+		wdev->sl.keypairs[slot] = keypair;
+		mutex_unlock(&wdev->sl.keypair_lock);
+	}
+}
+
+/* Use a pre-computed key pair if available, else generate one inline. The caller is responsible to
+ * call wfx_sl_keypair_free() on the result.
+ */
+static struct wfx_sl_keypair *wfx_sl_get_keypair(struct wfx_dev *wdev)
+{
+	struct wfx_sl_keypair *keypair = NULL;
+	int i;
+
+	mutex_lock(&wdev->sl.keypair_lock);
+	for (i = 0; i < ARRAY_SIZE(wdev->sl.keypairs); i++) {
+		if (wdev->sl.keypairs[i]) {
+			keypair = wdev->sl.keypairs[i];
+			wdev->sl.keypairs[i] = NULL;
+			break;
+		}
+	}
+	mutex_unlock(&wdev->sl.keypair_lock);
+	queue_work(system_unbound_wq, &wdev->sl.keypair_work);
+	if (keypair) {
+		wdev->sl.num_keypair_hits++;
+		return keypair;
+	}
+	wdev->sl.num_keypair_misses++;
+	return wfx_sl_keypair_alloc();
+}
+
+static int wfx_sl_send_pubkey(struct wfx_dev *wdev, const u8 *pubkey)
+{
+	u8 mac[SHA512_DIGEST_SIZE];
+	int ret;
+
+	ret = wfx_sl_get_pubkey_mac(wdev, pubkey, mac);
+	if (ret)
+		return -EIO;
+	reinit_completion(&wdev->sl.key_renew_done);
+	mutex_lock(&wdev->sl.aead_lock);
+	reinit_completion(&wdev->sl.key_switched);
+	WRITE_ONCE(wdev->sl.key_state, WFX_SL_KEY_EXCHANGE);
+	mutex_unlock(&wdev->sl.aead_lock);
+	ret = wfx_hif_sl_send_pub_keys(wdev, pubkey, mac);
+	if (!ret && wdev->poll_irq)
+		wfx_bh_poll_irq(wdev);
+	if (!ret && !wait_for_completion_timeout(&wdev->sl.key_renew_done, msecs_to_jiffies(500)))
+		ret = -ETIMEDOUT;
+
+	mutex_lock(&wdev->sl.aead_lock);
+	if (wdev->sl.key_state == WFX_SL_KEY_EXCHANGE) {
+		/* The chip did not answer and still uses the current key. A late answer is
+		 * ignored.
+		 */
+		WRITE_ONCE(wdev->sl.key_state, WFX_SL_KEY_STABLE);
+		mutex_unlock(&wdev->sl.aead_lock);
+		complete_all(&wdev->sl.key_switched);
+		return ret == -ETIMEDOUT ? ret : -EIO;
+	}
+	mutex_unlock(&wdev->sl.aead_lock);
+	return wfx_sl_switch_key(wdev);
+}
+
+static int wfx_sl_key_exchange(struct wfx_dev *wdev)
+{
+	int ret = -EIO;
+
+	wdev->sl.keypair = wfx_sl_get_keypair(wdev);
+	if (wdev->sl.keypair) {
+		ret = wfx_sl_send_pubkey(wdev, wdev->sl.keypair->pubkey);
+		wfx_sl_keypair_free(wdev->sl.keypair);
+		wdev->sl.keypair = NULL;
+	}
+	if (ret)
+		dev_err(wdev->dev, "key negociation error\n");
+	return ret;
+}
+
+/* Make-before-break renewal: the expensive generation of the key pair is done while the traffic
+ * continues with the current key. The data frames are never encrypted (see wfx_sl_init_cfg()), so
+ * they keep flowing during the whole renewal. Only the encrypted commands are held, from the
+ * request until the new key is installed. So, no encrypted message from the host is in flight when
+ * the keys change, whenever the firmware switches its own key. The messages from the chip switch
+ * to the new key right after its indication (see wfx_sl_check_pubkey()).
+ */
 static void wfx_sl_renew_key(struct work_struct *work)
 {
 	struct wfx_dev *wdev = container_of(work, struct wfx_dev, sl.key_renew_work);
+	ktime_t start, stall_start;
+	s64 stall_us;
+	int ret;
 
-	wfx_tx_lock_flush(wdev);
+	start = ktime_get();
+	wdev->sl.keypair = wfx_sl_get_keypair(wdev);
+	if (!wdev->sl.keypair) {
+		dev_err(wdev->dev, "cannot generate secure link key pair, keep current key\n");
+		trace_sl_renew_key(-EIO, ktime_us_delta(ktime_get(), start), 0);
+		return;
+	}
+	stall_start = ktime_get();
 	mutex_lock(&wdev->hif_cmd.key_renew_lock);
-	wfx_sl_key_exchange(wdev);
+	ret = wfx_sl_send_pubkey(wdev, wdev->sl.keypair->pubkey);
 	mutex_unlock(&wdev->hif_cmd.key_renew_lock);
-	wfx_tx_unlock(wdev);
+	stall_us = ktime_us_delta(ktime_get(), stall_start);
+	wfx_sl_keypair_free(wdev->sl.keypair);
+	wdev->sl.keypair = NULL;
+	if (ret)
+		dev_err(wdev->dev, "key renewal error: %d\n", ret);
+	wdev->sl.num_renewals++;
+	wdev->sl.last_renew_stall_us = stall_us;
+	wfx_hist_add(&wdev->sl.renew_stall, stall_us);
+	trace_sl_renew_key(ret, ktime_us_delta(stall_start, start), stall_us);
 }
 
 static void wfx_sl_init_cfg(struct wfx_dev *wdev)
@@ -241,16 +789,47 @@ static void wfx_sl_init_cfg(struct wfx_dev *wdev)
 	bitmap_copy(wdev->sl.commands, sl_commands, 256);
 }
 
+/* Called early during probe, so the first key pair is ready when the secure link is
+ * negotiated. The pool survives wfx_sl_deinit(), so it also speeds up the recovery of the chip.
+ */
+void wfx_sl_register(struct wfx_dev *wdev)
+{
+	mutex_init(&wdev->sl.keypair_lock);
+	mutex_init(&wdev->sl.aead_lock);
+	mutex_init(&wdev->sl.bench_lock);
+	INIT_WORK(&wdev->sl.keypair_work, wfx_sl_keypair_work);
+	if (memzcmp(wdev->pdata.slk_key, sizeof(wdev->pdata.slk_key)))
+		queue_work(system_unbound_wq, &wdev->sl.keypair_work);
+}
+
+void wfx_sl_unregister(struct wfx_dev *wdev)
+{
+	int i;
+
+	cancel_work_sync(&wdev->sl.keypair_work);
+	for (i = 0; i < ARRAY_SIZE(wdev->sl.keypairs); i++) {
+		wfx_sl_keypair_free(wdev->sl.keypairs[i]);
+		wdev->sl.keypairs[i] = NULL;
+	}
+	mutex_destroy(&wdev->sl.keypair_lock);
+	mutex_destroy(&wdev->sl.aead_lock);
+	kfree(wdev->sl.bench_report);
+	mutex_destroy(&wdev->sl.bench_lock);
+}
+
 int wfx_sl_init(struct wfx_dev *wdev)
 {
 	INIT_WORK(&wdev->sl.key_renew_work, wfx_sl_renew_key);
 	init_completion(&wdev->sl.key_renew_done);
+	init_completion(&wdev->sl.key_switched);
+	wdev->sl.key_state = WFX_SL_KEY_STABLE;
 	if (!memzcmp(wdev->pdata.slk_key, sizeof(wdev->pdata.slk_key)))
 		return -EIO;
 	if (wfx_api_older_than(wdev, 2, 0)) {
 		dev_info(wdev->dev, "this driver only support secure link API >= 2.0\n");
 		return -EIO;
 	}
+	wfx_sl_backend_init(wdev);
 	if (wdev->hw_caps.link_mode == SEC_LINK_ENFORCED) {
 		bitmap_set(wdev->sl.commands, HIF_REQ_ID_SL_CONFIGURE, 1);
 		if (wfx_sl_key_exchange(wdev))
@@ -270,7 +849,196 @@ int wfx_sl_init(struct wfx_dev *wdev)
 
 void wfx_sl_deinit(struct wfx_dev *wdev)
 {
+	cancel_work_sync(&wdev->sl.key_renew_work);
+	/* Also allows wfx_sl_init() to be called again after a reset of the chip */
+	bitmap_zero(wdev->sl.commands, 256);
 	mbedtls_ccm_free(&wdev->sl.ccm_ctxt);
+	wfx_sl_backend_deinit(wdev);
+}
+
+static void wfx_sl_bench_keypair(struct seq_buf *seq)
+{
+	mbedtls_ecdh_context *ecdh;
+	u8 pubkey[API_HOST_PUB_KEY_SIZE];
+	ktime_t start;
+	int i, ret = 0;
+
+	ecdh = kmalloc(sizeof(*ecdh), GFP_KERNEL);
+	if (!ecdh)
+		return;
+	start = ktime_get();
+	for (i = 0; i < WFX_SL_BENCH_PK_LOOPS && !ret; i++) {
+		ret = wfx_sl_make_keypair(ecdh, pubkey);
+		if (!ret)
+			mbedtls_ecdh_free(ecdh);
+	}
+	if (ret)
+		seq_buf_printf(seq, "  X25519 key pair: error %d\n", ret);
+	else
+		seq_buf_printf(seq, "  X25519 key pair: %lldus\n",
+			       div_s64(ktime_us_delta(ktime_get(), start), WFX_SL_BENCH_PK_LOOPS));
+	kfree_sensitive(ecdh);
+}
+
+/* Cost of a key exchange on the host side: generation of the key pair, shared secret and
+ * installation of the new key. The peer is emulated with another key pair.
+ */
+static void wfx_sl_bench_exchange(struct seq_buf *seq)
+{
+	struct {
+		mbedtls_ecdh_context local;
+		mbedtls_ecdh_context peer;
+		mbedtls_ccm_context ccm;
+		u8 local_pubkey[API_HOST_PUB_KEY_SIZE];
+		u8 peer_pubkey[API_HOST_PUB_KEY_SIZE];
+		u8 key[SHA256_DIGEST_SIZE];
+	} *t;
+	ktime_t start;
+	int i, ret;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return;
+	ret = wfx_sl_make_keypair(&t->peer, t->peer_pubkey);
+	if (ret)
+		goto end;
+	start = ktime_get();
+	for (i = 0; i < WFX_SL_BENCH_PK_LOOPS && !ret; i++) {
+		ret = wfx_sl_make_keypair(&t->local, t->local_pubkey);
+		if (ret)
+			break;
+		ret = wfx_sl_compute_key(&t->local, t->peer_pubkey, t->key);
+		if (!ret) {
+			mbedtls_ccm_init(&t->ccm);
+			ret = mbedtls_ccm_setkey(&t->ccm, MBEDTLS_CIPHER_ID_AES, t->key,
+						 16 * BITS_PER_BYTE);
+			mbedtls_ccm_free(&t->ccm);
+		}
+		mbedtls_ecdh_free(&t->local);
+	}
+	if (!ret)
+		seq_buf_printf(seq, "  X25519 key exchange: %lldus\n",
+			       div_s64(ktime_us_delta(ktime_get(), start), WFX_SL_BENCH_PK_LOOPS));
+	mbedtls_ecdh_free(&t->peer);
+end:
+	if (ret)
+		seq_buf_printf(seq, "  X25519 key exchange: error %d\n", ret);
+	kfree_sensitive(t);
+}
+
+static void wfx_sl_bench_mpi(struct seq_buf *seq)
+{
+	mbedtls_mpi a, e, n, x;
+	ktime_t start;
+	int i, ret;
+
+	mbedtls_mpi_init(&a);
+	mbedtls_mpi_init(&e);
+	mbedtls_mpi_init(&n);
+	mbedtls_mpi_init(&x);
+	ret = mbedtls_mpi_fill_random(&a, 64, mbedtls_random, NULL);
+	if (!ret)
+		ret = mbedtls_mpi_fill_random(&e, 64, mbedtls_random, NULL);
+	if (!ret)
+		ret = mbedtls_mpi_fill_random(&n, 64, mbedtls_random, NULL);
+	if (!ret)
+		ret = mbedtls_mpi_set_bit(&n, 0, 1);
+	if (!ret)
+		ret = mbedtls_mpi_set_bit(&n, 511, 1);
+	start = ktime_get();
+	for (i = 0; i < WFX_SL_BENCH_PK_LOOPS && !ret; i++)
+		ret = mbedtls_mpi_exp_mod(&x, &a, &e, &n, NULL);
+	if (ret)
+		seq_buf_printf(seq, "  512-bit modular exponentiation: error %08x\n", ret);
+	else
+		seq_buf_printf(seq, "  512-bit modular exponentiation: %lldus\n",
+			       div_s64(ktime_us_delta(ktime_get(), start), WFX_SL_BENCH_PK_LOOPS));
+	mbedtls_mpi_free(&a);
+	mbedtls_mpi_free(&e);
+	mbedtls_mpi_free(&n);
+	mbedtls_mpi_free(&x);
+}
+
+/* Benchmark is run with its own contexts and keys, so it does not disturb the traffic. The stall
+ * is the time the encrypted commands are held during a key renewal.
+ */
+void wfx_sl_show(struct seq_file *seq, struct wfx_dev *wdev)
+{
+	struct wfx_sl_aead *aead;
+
+	/* The bh may fall back to mbedtls and free the kernel backend in the meantime */
+	mutex_lock(&wdev->sl.aead_lock);
+	aead = wfx_sl_get_aead(wdev);
+	if (aead)
+		seq_printf(seq, "Backend: kernel (%s)\n", wfx_sl_aead_name(aead));
+	else
+		seq_puts(seq, "Backend: mbedtls\n");
+	mutex_unlock(&wdev->sl.aead_lock);
+	if (wdev->sl.aead_selftest)
+		seq_printf(seq, "Kernel self-test: failed (%d)\n", wdev->sl.aead_selftest);
+	else
+		seq_puts(seq, "Kernel self-test: passed\n");
+	seq_printf(seq, "Pre-computed key pairs used: %u\n", wdev->sl.num_keypair_hits);
+	seq_printf(seq, "Key pairs computed inline: %u\n", wdev->sl.num_keypair_misses);
+	seq_printf(seq, "Key renewals: %u\n", wdev->sl.num_renewals);
+	seq_printf(seq, "Last renewal stall: %lldus\n", wdev->sl.last_renew_stall_us);
+	wfx_hist_show(seq, "Renewal stall", &wdev->sl.renew_stall, "us");
+}
+
+static void wfx_sl_bench_run(struct seq_buf *seq)
+{
+	struct {
+		mbedtls_ccm_context ccm;
+		u8 key[16];
+		u8 clear[WFX_SL_BENCH_MSG_MAX];
+		u8 msg[WFX_SL_BENCH_MSG_MAX];
+	} *t;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return;
+	get_random_bytes(t->key, sizeof(t->key));
+	seq_buf_printf(seq, "Round trips (%d encode + decode of each HIF message):\n",
+		       WFX_SL_BENCH_LOOPS);
+	wfx_sl_bench_roundtrip(seq, &t->ccm, t->key, t->clear, t->msg);
+	kfree_sensitive(t);
+	seq_buf_printf(seq, "Public key operations (%zu-bit limbs%s):\n",
+		       sizeof(mbedtls_mpi_uint) * BITS_PER_BYTE,
+		       IS_ENABLED(MBEDTLS_HAVE_ASM) ? ", assembly" : "");
+	wfx_sl_bench_keypair(seq);
+	wfx_sl_bench_exchange(seq);
+	wfx_sl_bench_mpi(seq);
+}
+
+/* The benchmarks take seconds of CPU. So, they only run on request and their report is kept for
+ * the readers of debugfs.
+ */
+int wfx_sl_bench(struct wfx_dev *wdev)
+{
+	struct seq_buf report;
+	char *buf;
+
+	buf = kmalloc(WFX_SL_BENCH_REPORT_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	seq_buf_init(&report, buf, WFX_SL_BENCH_REPORT_SIZE);
+	wfx_sl_bench_run(&report);
+	mutex_lock(&wdev->sl.bench_lock);
+	kfree(wdev->sl.bench_report);
+	wdev->sl.bench_report = buf;
+	wdev->sl.bench_report_len = seq_buf_used(&report);
+	mutex_unlock(&wdev->sl.bench_lock);
+	return 0;
+}
+
+void wfx_sl_bench_show(struct seq_file *seq, struct wfx_dev *wdev)
+{
+	mutex_lock(&wdev->sl.bench_lock);
+	if (wdev->sl.bench_report)
+		seq_write(seq, wdev->sl.bench_report, wdev->sl.bench_report_len);
+	else
+		seq_puts(seq, "Write to this file to run the benchmarks\n");
+	mutex_unlock(&wdev->sl.bench_lock);
 }
 
 void wfx_sl_fill_pdata(struct device *dev, struct wfx_platform_data *pdata)
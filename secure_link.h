@@ -11,20 +11,66 @@ struct wfx_dev;
 
 #ifdef CONFIG_WFX_SECURE_LINK
 
+#include <linux/version.h>
 #include <linux/bitmap.h>
 #include <mbedtls/ecdh.h>
 #include <mbedtls/ccm.h>
 
+#include "debug.h"
+
+/* Kernel crypto API backend relies on crypto_wait_req() */
+#if defined(CONFIG_WFX_SL_KCRYPTO) && (KERNEL_VERSION(4, 13, 0) <= LINUX_VERSION_CODE)
+#define WFX_SL_KCRYPTO
+#endif
+
+#define WFX_SL_NUM_KEYPAIRS 2
+
+struct seq_file;
 struct wfx_platform_data;
+struct wfx_sl_aead;
+
+enum wfx_sl_key_state {
+	WFX_SL_KEY_STABLE,
+	WFX_SL_KEY_EXCHANGE, /* Public key sent, the chip has not answered */
+	WFX_SL_KEY_SWITCH,   /* The chip uses the new key, the host computes it */
+};
+
+struct wfx_sl_keypair {
+	mbedtls_ecdh_context ecdh;
+	u8                   pubkey[API_HOST_PUB_KEY_SIZE];
+};
 
 struct sl_context {
 	unsigned int         rx_seqnum;
 	unsigned int         tx_seqnum;
 	struct completion    key_renew_done;
 	struct work_struct   key_renew_work;
+	enum wfx_sl_key_state key_state;
+	struct completion    key_switched;
+	u8                   peer_pubkey[API_NCP_PUB_KEY_SIZE];
+	u8                   peer_pubkey_mac[API_NCP_PUB_KEY_MAC_SIZE];
 	DECLARE_BITMAP(commands, 256);
-	mbedtls_ecdh_context edch_ctxt; /* Only valid druing key negociation */
+	struct wfx_sl_keypair *keypair; /* Only valid during key negotiation */
 	mbedtls_ccm_context  ccm_ctxt;
+	mbedtls_ccm_context  ccm_next; /* Only valid during the switch of keys */
+	/* Kernel "ccm(aes)" transform using the same key than ccm_ctxt. NULL if not available. */
+	struct wfx_sl_aead   *aead;
+	struct mutex         aead_lock; /* Protects aead, ccm_ctxt and key_state */
+	int                  aead_selftest;
+	/* Ephemeral key pairs generated in advance */
+	struct mutex         keypair_lock;
+	struct work_struct   keypair_work;
+	struct wfx_sl_keypair *keypairs[WFX_SL_NUM_KEYPAIRS];
+	/* Statistics */
+	unsigned int         num_keypair_hits;
+	unsigned int         num_keypair_misses;
+	unsigned int         num_renewals;
+	s64                  last_renew_stall_us;
+	struct wfx_hist      renew_stall;
+	/* Last report of wfx_sl_bench() */
+	struct mutex         bench_lock;
+	char                 *bench_report;
+	size_t               bench_report_len;
 };
 
 int wfx_is_secure_command(struct wfx_dev *wdev, int cmd_id);
@@ -33,13 +79,19 @@ int wfx_sl_encode(struct wfx_dev *wdev,
 		  const struct wfx_hif_msg *input, struct wfx_hif_sl_msg *output);
 int wfx_sl_check_pubkey(struct wfx_dev *wdev,
 			const u8 *ncp_pubkey, const u8 *ncp_pubmac);
+void wfx_sl_register(struct wfx_dev *wdev);
+void wfx_sl_unregister(struct wfx_dev *wdev);
 int wfx_sl_init(struct wfx_dev *wdev);
 void wfx_sl_deinit(struct wfx_dev *wdev);
 void wfx_sl_fill_pdata(struct device *dev, struct wfx_platform_data *pdata);
+void wfx_sl_show(struct seq_file *seq, struct wfx_dev *wdev);
+int wfx_sl_bench(struct wfx_dev *wdev);
+void wfx_sl_bench_show(struct seq_file *seq, struct wfx_dev *wdev);
 
 #else /* CONFIG_WFX_SECURE_LINK */
 
 #include <linux/of.h>
+#include <linux/seq_file.h>
 
 struct sl_context {
 };
@@ -72,6 +124,14 @@ static inline void wfx_sl_fill_pdata(struct device *dev, struct wfx_platform_dat
 		dev_err(dev, "secure link is not supported by this driver, ignoring provided key\n");
 }
 
+static inline void wfx_sl_register(struct wfx_dev *wdev)
+{
+}
+
+static inline void wfx_sl_unregister(struct wfx_dev *wdev)
+{
+}
+
 static inline int wfx_sl_init(struct wfx_dev *wdev)
 {
 	return -EIO;
@@ -81,6 +141,21 @@ static inline void wfx_sl_deinit(struct wfx_dev *wdev)
 {
 }
 
+static inline void wfx_sl_show(struct seq_file *seq, struct wfx_dev *wdev)
+{
+	seq_puts(seq, "secure link is not supported by this driver\n");
+}
+
+static inline int wfx_sl_bench(struct wfx_dev *wdev)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void wfx_sl_bench_show(struct seq_file *seq, struct wfx_dev *wdev)
+{
+	seq_puts(seq, "secure link is not supported by this driver\n");
+}
+
 #endif /* CONFIG_WFX_SECURE_LINK */
 
 #endif
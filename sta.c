@@ -7,6 +7,7 @@
  */
 #include <linux/version.h>
 #include <linux/etherdevice.h>
+#include <linux/crc32.h>
 #include <net/mac80211.h>
 
 #include "sta.h"
@@ -31,12 +32,24 @@ static __always_inline void assign_bit(long nr, volatile unsigned long *addr, bo
 }
 #endif
 
+static bool ps_timeout_adaptive;
+module_param(ps_timeout_adaptive, bool, 0644);
+MODULE_PARM_DESC(ps_timeout_adaptive, "compute the power save timeout from the gaps between the frames instead of using the value of mac80211, applied at the next power save update (default: false).");
+
+static unsigned int ps_timeout_min = 10;
+module_param(ps_timeout_min, uint, 0644);
+MODULE_PARM_DESC(ps_timeout_min, "smallest power save timeout (in ms) chosen by the adaptive mode (default: 10).");
+
+static unsigned int ps_timeout_max = 100;
+module_param(ps_timeout_max, uint, 0644);
+MODULE_PARM_DESC(ps_timeout_max, "largest power save timeout (in ms) chosen by the adaptive mode (default: 100, max: 127).");
+
 void wfx_cooling_timeout_work(struct work_struct *work)
 {
 	struct wfx_dev *wdev = container_of(to_delayed_work(work), struct wfx_dev,
 					    cooling_timeout_work);
 
-	wdev->chip_frozen = true;
+	WRITE_ONCE(wdev->chip_frozen, true);
 	wfx_tx_unlock(wdev);
 }
 
@@ -179,6 +192,8 @@ static int wfx_get_ps_timeout(struct wfx_vif *wvif, bool *enable_ps)
 			return wvif->wdev->force_ps_timeout;
 		else if (wfx_api_older_than(wvif->wdev, 3, 2))
 			return 0;
+		else if (ps_timeout_adaptive && wvif->ps_adapt_timeout)
+			return wvif->ps_adapt_timeout;
 		else
 			return 30;
 	}
@@ -186,20 +201,201 @@ static int wfx_get_ps_timeout(struct wfx_vif *wvif, bool *enable_ps)
 		*enable_ps = vif->bss_conf.ps;
 	if (wvif->wdev->force_ps_timeout > -1)
 		return wvif->wdev->force_ps_timeout;
+	else if (vif->bss_conf.assoc && vif->bss_conf.ps &&
+		 ps_timeout_adaptive && wvif->ps_adapt_timeout)
+		return wvif->ps_adapt_timeout;
 	else if (vif->bss_conf.assoc && vif->bss_conf.ps)
 		return conf->dynamic_ps_timeout;
 	else
 		return -1;
 }
 
+/* The firmware cannot process a new power save request before the end of the previous transition
+ * (signaled by the indication HIF_IND_ID_SET_PM_MODE_CMPL). So wfx_update_pm() only records the
+ * wanted state and update_pm_work sends it when the firmware is ready. If the state changes several
+ * times in the meantime, only the last one is sent. It is not sent if the firmware already has it.
+ */
+static void wfx_update_pm_work(struct work_struct *work)
+{
+	struct wfx_vif *wvif = container_of(work, struct wfx_vif, update_pm_work);
+	int ps_timeout;
+	bool ps;
+
+	spin_lock_bh(&wvif->pm_lock);
+	if (!wvif->pm_req_pending || wvif->pm_dying)
+		goto unlock;
+	/* The association may have been lost since the request */
+	if (!wvif_to_vif(wvif)->bss_conf.assoc) {
+		wvif->pm_req_pending = false;
+		goto unlock;
+	}
+	if (wvif->pm_fw_known && wvif->pm_fw_ps == wvif->pm_req_ps &&
+	    wvif->pm_fw_ps_timeout == wvif->pm_req_ps_timeout) {
+		wvif->pm_req_pending = false;
+		goto unlock;
+	}
+	/* wfx_set_pm_mode_complete() will run this work again */
+	if (!try_wait_for_completion(&wvif->set_pm_mode_complete))
+		goto unlock;
+	ps = wvif->pm_req_ps;
+	ps_timeout = wvif->pm_req_ps_timeout;
+	wvif->pm_req_pending = false;
+	wvif->pm_fw_known = true;
+	wvif->pm_fw_ps = ps;
+	wvif->pm_fw_ps_timeout = ps_timeout;
+	spin_unlock_bh(&wvif->pm_lock);
+
+	schedule_delayed_work(&wvif->set_pm_mode_timeout_work, TU_TO_JIFFIES(512));
+	if (wfx_hif_set_pm(wvif, ps, ps_timeout)) {
+		spin_lock_bh(&wvif->pm_lock);
+		wvif->pm_fw_known = false;
+		spin_unlock_bh(&wvif->pm_lock);
+		if (cancel_delayed_work(&wvif->set_pm_mode_timeout_work))
+			complete(&wvif->set_pm_mode_complete);
+	}
+	return;
+
+unlock:
+	spin_unlock_bh(&wvif->pm_lock);
+}
+
+static void wfx_update_pm_request(struct wfx_vif *wvif)
+{
+	spin_lock_bh(&wvif->pm_lock);
+	if (!wvif->pm_dying)
+		schedule_work(&wvif->update_pm_work);
+	spin_unlock_bh(&wvif->pm_lock);
+}
+
+static void wfx_set_pm_mode_timeout_work(struct work_struct *work)
+{
+	struct wfx_vif *wvif = container_of(to_delayed_work(work), struct wfx_vif,
+					    set_pm_mode_timeout_work);
+
+	dev_warn(wvif->wdev->dev, "timeout while waiting of set_pm_mode_complete\n");
+	complete(&wvif->set_pm_mode_complete);
+	wfx_update_pm_request(wvif);
+}
+
+void wfx_set_pm_mode_complete(struct wfx_vif *wvif)
+{
+	/* Ignore the indication if the timeout has already released the transition */
+	if (cancel_delayed_work(&wvif->set_pm_mode_timeout_work))
+		complete(&wvif->set_pm_mode_complete);
+	wfx_update_pm_request(wvif);
+}
+
+/* Stop the power save state machine of a vif that goes away. Once this function returns, only
+ * set_pm_mode_timeout_work may still be pending.
+ */
+void wfx_update_pm_stop(struct wfx_vif *wvif)
+{
+	spin_lock_bh(&wvif->pm_lock);
+	wvif->pm_dying = true;
+	spin_unlock_bh(&wvif->pm_lock);
+	cancel_delayed_work_sync(&wvif->ps_adapt_work);
+	cancel_work_sync(&wvif->update_pm_work);
+}
+
+/* Called for each data frame sent or received. Maintain the average gap between the frames of
+ * each AC.
+ */
+void wfx_ps_adapt_packet(struct wfx_vif *wvif, int ac)
+{
+	ktime_t now, last;
+	s64 gap_us;
+
+	if (!ps_timeout_adaptive || ac < 0 || ac >= IEEE80211_NUM_ACS)
+		return;
+	now = ktime_get();
+	spin_lock_bh(&wvif->ps_adapt_lock);
+	last = wvif->ps_adapt_last_pkt[ac];
+	wvif->ps_adapt_last_pkt[ac] = now;
+	if (ktime_to_ns(last)) {
+		gap_us = min_t(s64, ktime_us_delta(now, last), USEC_PER_SEC);
+		if (!wvif->ps_adapt_gap_us[ac])
+			wvif->ps_adapt_gap_us[ac] = gap_us;
+		else
+			wvif->ps_adapt_gap_us[ac] += (gap_us - wvif->ps_adapt_gap_us[ac]) / 8;
+	}
+	spin_unlock_bh(&wvif->ps_adapt_lock);
+}
+
+/* The device should stay awake a bit longer than the usual gap between two frames. If there is no
+ * traffic or if the frames are too far apart, it is better to go to sleep as soon as possible.
+ */
+static int wfx_ps_adapt_target(struct wfx_vif *wvif)
+{
+	/* The firmware does not support more than 127ms, see wfx_hif_set_pm() */
+	int max_ms = min(ps_timeout_max, 127U);
+	int min_ms = min_t(int, ps_timeout_min, max_ms);
+	s64 gap_us = USEC_PER_SEC;
+	ktime_t now = ktime_get();
+	int target, i;
+
+	spin_lock_bh(&wvif->ps_adapt_lock);
+	for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+		if (!ktime_to_ns(wvif->ps_adapt_last_pkt[i]) ||
+		    ktime_ms_delta(now, wvif->ps_adapt_last_pkt[i]) > MSEC_PER_SEC)
+			continue;
+		gap_us = min(gap_us, wvif->ps_adapt_gap_us[i]);
+	}
+	spin_unlock_bh(&wvif->ps_adapt_lock);
+	target = DIV_ROUND_UP((u32)gap_us * 3 / 2, USEC_PER_MSEC);
+	if (target > max_ms)
+		return min_ms;
+	return max(target, min_ms);
+}
+
+/* Increases of the timeout are applied immediately since going to sleep in the middle of a burst is
+ * costly. Decreases wait for the traffic to be stable for a few seconds.
+ *
+ * This work is only armed by wfx_update_pm(). So, if ps_timeout_adaptive is enabled while the
+ * station is associated, it is taken into account at the next update of the power save state.
+ */
+static void wfx_ps_adapt_work(struct work_struct *work)
+{
+	struct wfx_vif *wvif = container_of(to_delayed_work(work), struct wfx_vif, ps_adapt_work);
+	struct ieee80211_vif *vif = wvif_to_vif(wvif);
+	int cur, target, i;
+
+	if (!ps_timeout_adaptive || !vif->bss_conf.assoc)
+		return;
+	target = wfx_ps_adapt_target(wvif);
+	/* wfx_update_pm() resets ps_adapt_timeout on disassociation */
+	mutex_lock(&wvif->wdev->conf_mutex);
+	cur = wvif->ps_adapt_timeout;
+	if (!cur || target * 4 > cur * 5 ||
+	    (target * 4 < cur * 3 && time_after(jiffies, wvif->ps_adapt_last_change + 2 * HZ))) {
+		i = wvif->ps_adapt_hist_cnt++ % WFX_PS_ADAPT_HIST_LEN;
+		wvif->ps_adapt_hist_val[i] = target;
+		wvif->ps_adapt_hist_time[i] = jiffies;
+		wvif->ps_adapt_timeout = target;
+		wvif->ps_adapt_last_change = jiffies;
+		wfx_update_pm(wvif);
+	}
+	mutex_unlock(&wvif->wdev->conf_mutex);
+	spin_lock_bh(&wvif->pm_lock);
+	if (!wvif->pm_dying)
+		schedule_delayed_work(&wvif->ps_adapt_work, HZ / 2);
+	spin_unlock_bh(&wvif->pm_lock);
+}
+
 int wfx_update_pm(struct wfx_vif *wvif)
 {
 	struct ieee80211_vif *vif = wvif_to_vif(wvif);
 	int ps_timeout;
 	bool ps;
 
-	if (!vif->bss_conf.assoc)
+	if (!vif->bss_conf.assoc) {
+		/* The firmware forgets the power save state with the association */
+		spin_lock_bh(&wvif->pm_lock);
+		wvif->pm_fw_known = false;
+		wvif->pm_req_pending = false;
+		spin_unlock_bh(&wvif->pm_lock);
+		wvif->ps_adapt_timeout = 0;
 		return 0;
+	}
 	ps_timeout = wfx_get_ps_timeout(wvif, &ps);
 	if (!ps)
 		ps_timeout = 0;
@@ -207,9 +403,18 @@ int wfx_update_pm(struct wfx_vif *wvif)
 	if (wvif->uapsd_mask)
 		ps_timeout = 0;
 
-	if (!wait_for_completion_timeout(&wvif->set_pm_mode_complete, TU_TO_JIFFIES(512)))
-		dev_warn(wvif->wdev->dev, "timeout while waiting of set_pm_mode_complete\n");
-	return wfx_hif_set_pm(wvif, ps, ps_timeout);
+	spin_lock_bh(&wvif->pm_lock);
+	/* wfx_reset() also updates the other vifs, including a vif being removed */
+	if (!wvif->pm_dying) {
+		wvif->pm_req_ps = ps;
+		wvif->pm_req_ps_timeout = ps_timeout;
+		wvif->pm_req_pending = true;
+		if (ps_timeout_adaptive)
+			schedule_delayed_work(&wvif->ps_adapt_work, HZ / 2);
+		schedule_work(&wvif->update_pm_work);
+	}
+	spin_unlock_bh(&wvif->pm_lock);
+	return 0;
 }
 
 int wfx_conf_tx(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
@@ -287,12 +492,27 @@ void wfx_reset(struct wfx_vif *wvif)
 	struct wfx_dev *wdev = wvif->wdev;
 
 	wfx_tx_lock_flush(wdev);
+	/* A request sent after the reset would leave pm_fw_known set on a state that the firmware
+	 * forgot. With pm_req_pending cleared, a later run of update_pm_work does nothing.
+	 */
+	spin_lock_bh(&wvif->pm_lock);
+	wvif->pm_req_pending = false;
+	spin_unlock_bh(&wvif->pm_lock);
+	cancel_work_sync(&wvif->update_pm_work);
 	wfx_hif_reset(wvif, false);
+	spin_lock_bh(&wvif->pm_lock);
+	wvif->pm_fw_known = false;
+	spin_unlock_bh(&wvif->pm_lock);
 	wfx_tx_policy_init(wvif);
 	if (wvif_count(wdev) <= 1)
 		wfx_hif_set_block_ack_policy(wvif, 0xFF, 0xFF);
 	wfx_tx_unlock(wdev);
 	wvif->join_in_progress = false;
+	wvif->template_valid = 0;
+	cancel_delayed_work_sync(&wvif->update_tim_work);
+	mutex_lock(&wvif->tim_lock);
+	wvif->tim_len = 0;
+	mutex_unlock(&wvif->tim_lock);
 	cancel_delayed_work_sync(&wvif->beacon_loss_work);
 	wvif =  NULL;
 	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
@@ -341,6 +561,55 @@ int wfx_sta_remove(struct ieee80211_hw *hw, struct ieee80211_vif *vif, struct ie
 	/* FIXME add a mutex? */
 	wfx_hif_map_link(wvif, true, sta->addr, sta_priv->link_id, false);
 	wvif->link_id_map &= ~BIT(sta_priv->link_id);
+	if (sta->aid <= IEEE80211_MAX_AID && test_and_clear_bit(sta->aid, wvif->tim_aids))
+		wfx_update_tim_request(wvif);
+	return 0;
+}
+
+/* The TIM is updated by update_tim_work and the DTIM count changes on each call to
+ * ieee80211_beacon_get(). So, the TIM is not taken into account to detect the changes of a beacon.
+ */
+static u32 wfx_template_hash(struct sk_buff *skb, u8 frame_type, int init_rate)
+{
+	const int ieoffset = offsetof(struct ieee80211_mgmt, u.beacon.variable);
+	const u8 *tim = NULL;
+	u32 hash = crc32(~0, &init_rate, sizeof(init_rate));
+
+	if (frame_type == HIF_TMPLT_BCN && skb->len > ieoffset)
+		tim = cfg80211_find_ie(WLAN_EID_TIM, skb->data + ieoffset, skb->len - ieoffset);
+	if (!tim)
+		return crc32(hash, skb->data, skb->len);
+	hash = crc32(hash, skb->data, tim - skb->data);
+	tim += tim[1] + 2;
+	return crc32(hash, tim, skb_tail_pointer(skb) - tim);
+}
+
+/* Do not send the template if the firmware already has the same one */
+int wfx_upload_template(struct wfx_vif *wvif, struct sk_buff *skb, u8 frame_type, int init_rate)
+{
+	u32 hash = wfx_template_hash(skb, frame_type, init_rate);
+	int ret;
+
+	if (WARN_ON(frame_type >= ARRAY_SIZE(wvif->template_hash)))
+		return -EINVAL;
+	if (test_bit(frame_type, &wvif->template_valid) &&
+	    wvif->template_hash[frame_type] == hash)
+		return 0;
+	/* Do not let update_tim_work record a TIM that the template has just overwritten */
+	mutex_lock(&wvif->tim_lock);
+	ret = wfx_hif_set_template_frame(wvif, skb, frame_type, init_rate);
+	if (frame_type == HIF_TMPLT_BCN && wvif_to_vif(wvif)->type == NL80211_IFTYPE_AP) {
+		/* The TIM of the template replaces the one of the firmware */
+		wvif->tim_len = 0;
+		wfx_update_tim_request(wvif);
+	}
+	mutex_unlock(&wvif->tim_lock);
+	if (ret) {
+		clear_bit(frame_type, &wvif->template_valid);
+		return ret;
+	}
+	wvif->template_hash[frame_type] = hash;
+	set_bit(frame_type, &wvif->template_valid);
 	return 0;
 }
 
@@ -352,13 +621,13 @@ static int wfx_upload_ap_templates(struct wfx_vif *wvif)
 	skb = ieee80211_beacon_get(wvif->wdev->hw, vif);
 	if (!skb)
 		return -ENOMEM;
-	wfx_hif_set_template_frame(wvif, skb, HIF_TMPLT_BCN, API_RATE_INDEX_B_1MBPS);
+	wfx_upload_template(wvif, skb, HIF_TMPLT_BCN, API_RATE_INDEX_B_1MBPS);
 	dev_kfree_skb(skb);
 
 	skb = ieee80211_proberesp_get(wvif->wdev->hw, vif);
 	if (!skb)
 		return -ENOMEM;
-	wfx_hif_set_template_frame(wvif, skb, HIF_TMPLT_PRBRES, API_RATE_INDEX_B_1MBPS);
+	wfx_upload_template(wvif, skb, HIF_TMPLT_PRBRES, API_RATE_INDEX_B_1MBPS);
 	dev_kfree_skb(skb);
 	return 0;
 }
@@ -608,41 +877,86 @@ void wfx_bss_info_changed(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	mutex_unlock(&wdev->conf_mutex);
 }
 
-static int wfx_update_tim(struct wfx_vif *wvif)
+/* Build the TIM element the same way than mac80211 does (see ieee80211_beacon_add_tim()), but
+ * without building the whole beacon. Return the length of the element.
+ */
+static int wfx_build_tim(struct wfx_vif *wvif, u8 *tim)
 {
 	struct ieee80211_vif *vif = wvif_to_vif(wvif);
-	struct sk_buff *skb;
-	u16 tim_offset, tim_length;
-	u8 *tim_ptr;
-
-	skb = ieee80211_beacon_get_tim(wvif->wdev->hw, vif, &tim_offset,
-				       &tim_length);
-	if (!skb)
-		return -ENOENT;
-	tim_ptr = skb->data + tim_offset;
-
-	if (tim_offset && tim_length >= 6) {
-		/* Firmware handles DTIM counter internally */
-		tim_ptr[2] = 0;
-
-		/* Set/reset aid0 bit */
-		if (wfx_tx_queues_has_cab(wvif))
-			tim_ptr[4] |= 1;
-		else
-			tim_ptr[4] &= ~1;
+	u8 bitmap[IEEE80211_MAX_TIM_LEN] = { };
+	int aid, i, n1 = 0, n2 = 0;
+	bool found = false;
+
+	for_each_set_bit(aid, wvif->tim_aids, IEEE80211_MAX_AID + 1)
+		bitmap[aid / 8] |= BIT(aid % 8);
+	for (i = 0; i < IEEE80211_MAX_TIM_LEN; i++) {
+		if (bitmap[i]) {
+			if (!found)
+				n1 = i & 0xfe;
+			n2 = i;
+			found = true;
+		}
+	}
+	tim[0] = WLAN_EID_TIM;
+	tim[2] = 0; /* Firmware handles DTIM counter internally */
+	tim[3] = vif->bss_conf.dtim_period;
+	tim[4] = n1;
+	if (wfx_tx_queues_has_cab(wvif))
+		tim[4] |= 1;
+	if (!found) {
+		tim[1] = 4;
+		tim[5] = 0;
+		return 6;
 	}
+	tim[1] = n2 - n1 + 4;
+	memcpy(tim + 5, bitmap + n1, n2 - n1 + 1);
+	return tim[1] + 2;
+}
 
-	wfx_hif_update_ie_beacon(wvif, tim_ptr, tim_length);
-	dev_kfree_skb(skb);
+/* wvif->tim_lock must be held */
+static int wfx_update_tim(struct wfx_vif *wvif)
+{
+	u8 tim[sizeof(wvif->tim)];
+	int len, ret;
 
+	len = wfx_build_tim(wvif, tim);
+	if (len == wvif->tim_len && !memcmp(tim, wvif->tim, len)) {
+		wvif->tim_num_skipped++;
+		return 0;
+	}
+	ret = wfx_hif_update_ie_beacon(wvif, tim, len);
+	if (ret) {
+		wvif->tim_len = 0;
+		return ret;
+	}
+	memcpy(wvif->tim, tim, len);
+	wvif->tim_len = len;
+	wvif->tim_last_update = jiffies;
+	wvif->tim_num_sent++;
 	return 0;
 }
 
 static void wfx_update_tim_work(struct work_struct *work)
 {
-	struct wfx_vif *wvif = container_of(work, struct wfx_vif, update_tim_work);
+	struct wfx_vif *wvif = container_of(to_delayed_work(work), struct wfx_vif,
+					    update_tim_work);
 
+	mutex_lock(&wvif->tim_lock);
 	wfx_update_tim(wvif);
+	mutex_unlock(&wvif->tim_lock);
+}
+
+/* The changes of the TIM are coalesced: the firmware receives at most one update per beacon
+ * interval. The first change after a quiet period is sent immediately.
+ */
+void wfx_update_tim_request(struct wfx_vif *wvif)
+{
+	struct ieee80211_vif *vif = wvif_to_vif(wvif);
+	unsigned long next = wvif->tim_last_update +
+			     usecs_to_jiffies(vif->bss_conf.beacon_int * USEC_PER_TU);
+
+	schedule_delayed_work(&wvif->update_tim_work,
+			      time_after(next, jiffies) ? next - jiffies : 0);
 }
 
 int wfx_set_tim(struct ieee80211_hw *hw, struct ieee80211_sta *sta, bool set)
@@ -655,7 +969,13 @@ int wfx_set_tim(struct ieee80211_hw *hw, struct ieee80211_sta *sta, bool set)
 		dev_warn(wdev->dev, "%s: received event for non-existent vif\n", __func__);
 		return -EIO;
 	}
-	schedule_work(&wvif->update_tim_work);
+	if (sta->aid > IEEE80211_MAX_AID)
+		return -EINVAL;
+	if (set)
+		set_bit(sta->aid, wvif->tim_aids);
+	else
+		clear_bit(sta->aid, wvif->tim_aids);
+	wfx_update_tim_request(wvif);
 	return 0;
 }
 
@@ -783,11 +1103,28 @@ int wfx_add_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 	wvif->wdev = wdev;
 
 	wvif->link_id_map = 1; /* link-id 0 is reserved for multicast */
-	INIT_WORK(&wvif->update_tim_work, wfx_update_tim_work);
+	wvif->template_valid = 0;
+	INIT_DELAYED_WORK(&wvif->update_tim_work, wfx_update_tim_work);
+	bitmap_zero(wvif->tim_aids, IEEE80211_MAX_AID + 1);
+	mutex_init(&wvif->tim_lock);
+	wvif->tim_len = 0;
+	wvif->tim_last_update = jiffies - HZ;
 	INIT_DELAYED_WORK(&wvif->beacon_loss_work, wfx_beacon_loss_work);
 
 	init_completion(&wvif->set_pm_mode_complete);
 	complete(&wvif->set_pm_mode_complete);
+	INIT_WORK(&wvif->update_pm_work, wfx_update_pm_work);
+	INIT_DELAYED_WORK(&wvif->set_pm_mode_timeout_work, wfx_set_pm_mode_timeout_work);
+	spin_lock_init(&wvif->pm_lock);
+	wvif->pm_dying = false;
+	wvif->pm_req_pending = false;
+	wvif->pm_fw_known = false;
+	INIT_DELAYED_WORK(&wvif->ps_adapt_work, wfx_ps_adapt_work);
+	spin_lock_init(&wvif->ps_adapt_lock);
+	memset(wvif->ps_adapt_last_pkt, 0, sizeof(wvif->ps_adapt_last_pkt));
+	memset(wvif->ps_adapt_gap_us, 0, sizeof(wvif->ps_adapt_gap_us));
+	wvif->ps_adapt_timeout = 0;
+	wvif->ps_adapt_hist_cnt = 0;
 	INIT_WORK(&wvif->tx_policy_upload_work, wfx_tx_policy_upload_work);
 
 	init_completion(&wvif->scan_complete);
@@ -826,7 +1163,10 @@ void wfx_remove_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 	struct wfx_dev *wdev = hw->priv;
 	struct wfx_vif *wvif = (struct wfx_vif *)vif->drv_priv;
 
+	wfx_update_pm_stop(wvif);
+	/* Let the firmware finish the current transition */
 	wait_for_completion_timeout(&wvif->set_pm_mode_complete, msecs_to_jiffies(300));
+	cancel_delayed_work_sync(&wvif->set_pm_mode_timeout_work);
 	wfx_tx_queues_check_empty(wvif);
 
 	mutex_lock(&wdev->conf_mutex);
@@ -838,6 +1178,9 @@ void wfx_remove_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 
 	cancel_delayed_work_sync(&wvif->beacon_loss_work);
 	wdev->vif[wvif->id] = NULL;
+	/* Nothing can request a TIM update once the vif is unreachable */
+	cancel_delayed_work_sync(&wvif->update_tim_work);
+	mutex_destroy(&wvif->tim_lock);
 
 	mutex_unlock(&wdev->conf_mutex);
 
@@ -73,8 +73,13 @@ void wfx_suspend_hot_dev(struct wfx_dev *wdev, enum sta_notify_cmd cmd);
 void wfx_suspend_resume_mc(struct wfx_vif *wvif, enum sta_notify_cmd cmd);
 void wfx_event_report_rssi(struct wfx_vif *wvif, u8 raw_rcpi_rssi);
 int wfx_update_pm(struct wfx_vif *wvif);
+void wfx_update_pm_stop(struct wfx_vif *wvif);
+void wfx_set_pm_mode_complete(struct wfx_vif *wvif);
+void wfx_ps_adapt_packet(struct wfx_vif *wvif, int ac);
 
 /* Other Helpers */
 void wfx_reset(struct wfx_vif *wvif);
+int wfx_upload_template(struct wfx_vif *wvif, struct sk_buff *skb, u8 frame_type, int init_rate);
+void wfx_update_tim_request(struct wfx_vif *wvif);
 
 #endif
@@ -439,6 +439,26 @@ TRACE_EVENT(tx_stats,
 );
 #define _trace_tx_stats(tx_cnf, skb, delay) trace_tx_stats(tx_cnf, skb, delay)
 
+TRACE_EVENT(sl_renew_key,
+	TP_PROTO(int ret, s64 keygen_us, s64 stall_us),
+	TP_ARGS(ret, keygen_us, stall_us),
+	TP_STRUCT__entry(
+		__field(int, ret)
+		__field(s64, keygen_us)
+		__field(s64, stall_us)
+	),
+	TP_fast_assign(
+		__entry->ret = ret;
+		__entry->keygen_us = keygen_us;
+		__entry->stall_us = stall_us;
+	),
+	TP_printk("secure link key renewal: %s, key pair generated in %lldus, traffic stalled during %lldus",
+		__entry->ret ? "failed" : "done",
+		__entry->keygen_us,
+		__entry->stall_us
+	)
+);
+
 TRACE_EVENT(queues_stats,
 	TP_PROTO(struct wfx_dev *wdev, const struct wfx_queue *elected_queue),
 	TP_ARGS(wdev, elected_queue),
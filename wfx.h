@@ -17,6 +17,8 @@
 #include <net/mac80211.h>
 
 #include "bh.h"
+#include "fwio.h"
+#include "hwio.h"
 #include "data_tx.h"
 #include "main.h"
 #include "queue.h"
@@ -25,6 +27,7 @@
 
 #define USEC_PER_TXOP 32 /* see struct ieee80211_tx_queue_params */
 #define USEC_PER_TU 1024
+#define WFX_PS_ADAPT_HIST_LEN 16
 
 #if (KERNEL_VERSION(4, 16, 0) > LINUX_VERSION_CODE)
 #define array_index_nospec(index, size) index
@@ -85,12 +88,26 @@ struct wfx_dev {
 	u8                         keyset;
 	struct completion          firmware_ready;
 	struct wfx_hif_ind_startup hw_caps;
+	struct wfx_fw_stats        fw_stats;
+	struct wfx_io_stats        io_stats;
 	struct wfx_hif             hif;
 	struct sl_context          sl;
 	struct delayed_work        cooling_timeout_work;
 	bool                       poll_irq;
 	bool                       chip_frozen;
+	struct work_struct         recovery_work;
+	bool                       recovery_blocked;
+	unsigned int               num_recoveries;
+	unsigned int               num_recovery_failures;
+	s64                        last_recovery_us;
+	s64                        max_recovery_us;
 	struct mutex               scan_lock;
+	bool                       scan_paused;
+	/* Last time a BSS was seen on each channel (indexed by channel number) and last time all
+	 * the channels were scanned, in jiffies
+	 */
+	unsigned long              scan_bss_seen[15];
+	unsigned long              scan_last_full;
 	struct mutex               conf_mutex;
 
 	struct wfx_hif_cmd         hif_cmd;
@@ -122,7 +139,29 @@ struct wfx_vif {
 
 	bool                       after_dtim_tx_allowed;
 	bool                       join_in_progress;
+	/* Power save state machine, see wfx_update_pm() */
 	struct completion          set_pm_mode_complete;
+	struct work_struct         update_pm_work;
+	struct delayed_work        set_pm_mode_timeout_work;
+	spinlock_t                 pm_lock;
+	bool                       pm_dying; /* Nothing may be scheduled anymore */
+	bool                       pm_req_pending;
+	bool                       pm_req_ps;
+	int                        pm_req_ps_timeout;
+	bool                       pm_fw_known;
+	bool                       pm_fw_ps;
+	int                        pm_fw_ps_timeout;
+	/* PS timeout computed from the traffic, see wfx_ps_adapt_work() */
+	struct delayed_work        ps_adapt_work;
+	spinlock_t                 ps_adapt_lock; /* Protects the two arrays below */
+	ktime_t                    ps_adapt_last_pkt[IEEE80211_NUM_ACS];
+	s64                        ps_adapt_gap_us[IEEE80211_NUM_ACS];
+	/* ps_adapt_timeout and the fields below are protected by conf_mutex */
+	int                        ps_adapt_timeout; /* in ms, 0 if not yet computed */
+	unsigned long              ps_adapt_last_change;
+	int                        ps_adapt_hist_val[WFX_PS_ADAPT_HIST_LEN];
+	unsigned long              ps_adapt_hist_time[WFX_PS_ADAPT_HIST_LEN];
+	unsigned int               ps_adapt_hist_cnt;
 
 	struct delayed_work        beacon_loss_work;
 
@@ -130,7 +169,19 @@ struct wfx_vif {
 	struct wfx_tx_policy_cache tx_policy_cache;
 	struct work_struct         tx_policy_upload_work;
 
-	struct work_struct         update_tim_work;
+	struct delayed_work        update_tim_work;
+	/* TIM of the beacon, built from the calls to wfx_set_tim() */
+	DECLARE_BITMAP(tim_aids, IEEE80211_MAX_AID + 1);
+	struct mutex               tim_lock; /* Protects tim and tim_len */
+	u8                         tim[IEEE80211_MAX_TIM_LEN + 5];
+	int                        tim_len; /* 0 if the firmware TIM is unknown */
+	unsigned long              tim_last_update;
+	unsigned long              tim_num_sent;
+	unsigned long              tim_num_skipped;
+
+	/* Hashes of the templates known by the firmware */
+	u32                        template_hash[HIF_TMPLT_NA + 1];
+	unsigned long              template_valid;
 
 	unsigned long              uapsd_mask;
 